@@ -0,0 +1,28 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// === Suivi de dérive de la ligne de repos ===
+// Les offsets des capteurs hall dérivent avec la température pendant un concert, alors que
+// gThLow ne bouge qu'à la calibration manuelle. Ce suivi observe chaque touche fermement IDLE
+// (au repos depuis un moment, côté repos de Low), met à jour une EMA lente du repos en Q8 en
+// rejetant les échantillons aberrants, puis fait glisser Low (même marge qu'à l'ancrage)
+// d'au plus 1 count par kDriftStepMs. Toute modification externe de Low (calibration, SysEx)
+// ré-ancre la touche. Les seuils ne sont sauvegardés qu'occasionnellement (kDriftPersistMs).
+// Les mêmes échantillons donnent le sigma du bruit de repos (MAD en Q8) publié dans
+// gNoiseSigmaQ4, d'où découlent les marges Low/High/Release (CalibCfg::k*SigmaK).
+namespace BaselineTracker {
+    void init();
+    // Visite quelques touches par appel (rythmé par kDriftVisitUs), pas de travail sinon
+    void service(uint32_t nowUs, uint32_t nowMs);
+
+    // Seuils décalés par un autre module (compensation en température): suivre sans ré-ancrer
+    void followShift(uint8_t mux, uint8_t ch);
+
+    // Diagnostic: repos estimé (counts) et déplacement cumulé de Low depuis l'ancrage
+    uint16_t restEstimate(uint8_t mux, uint8_t ch);
+    int16_t  driftCounts(uint8_t mux, uint8_t ch);
+    uint32_t rejectedSamples();
+    // Rapport série du sigma de repos par touche (DEBUG_NOISE_REPORT)
+    void printNoiseReport();
+}
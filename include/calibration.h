@@ -24,15 +24,24 @@ namespace Calib {
 		constexpr uint32_t kHoldToStartMs    = 3000;  // hold 3s to start
 		constexpr uint32_t kHoldToFinishMs   = 1000;  // hold 1s to end Phase2
 		constexpr uint16_t kMinSwingForHigh  = 50;    // if |High-Low| < this, fallback
+		// Finalisation découpée: au plus N touches et ce budget par tour de loop()
+		constexpr uint8_t  kFinalizeKeysPerSlice = 8;
+		constexpr uint32_t kFinalizeBudgetUs     = 50;
 }
 
 // Tables runtime (initialisées dans calibration.cpp)
 extern uint16_t gThLow[N_MUX][N_CH];
 extern uint16_t gThHigh[N_MUX][N_CH];
 extern uint8_t  gHighFastSeen[N_MUX][N_CH];
+// Release précalculé (lu à chaque échantillon par la FSM): rafraîchir via calibUpdateRelease
+extern uint16_t gThRelease[N_MUX][N_CH];
+// Sigma du bruit de repos en Q4 (counts * 16), 0 = inconnu. Estimé par BaselineTracker.
+extern uint8_t  gNoiseSigmaQ4[N_MUX][N_CH];
 
 // Initialisation statique (Phase1): valeurs de base avant médiane (Phase2)
 void calibrationInitStatic();
+// true si calibrationInitStatic a chargé des seuils calibrés (EEPROM), false = placeholders
+bool calibrationLoaded();
 // Mise à jour High après NoteOff avec peak détecté
 void updateHighAfterNote(uint8_t mux, uint8_t ch, uint16_t peak);
 // Phase2 API
@@ -41,10 +50,20 @@ void calibrationFrameIngest(const uint16_t frameValues[N_MUX][N_CH]);
 void calibrationService();
 bool calibrationIsCollecting();
 bool calibrationIsRunning();
+// true hors de toute séquence bouton 24 (ni maintien, ni phase, ni finalisation/sauvegarde)
+bool calibrationUxIdle();
+
+// Phase2: capture des pics par échantillon (appelé par VelocityEngine::processChannel, avant le
+// préfiltre). Hors Phase2 le coût se réduit au test d'un drapeau, marqué improbable.
+extern volatile bool gCalibPeakCapture;
+void calibrationPeakSample(uint8_t channel, const uint16_t values[N_MUX]);
+inline void calibrationPeakHook(uint8_t channel, const uint16_t values[N_MUX]) {
+	if (__builtin_expect(gCalibPeakCapture, 0)) calibrationPeakSample(channel, values);
+}
 
 // Calibration control API (FSM)
 void calibrationLoadFromEeprom();
-void calibrationSaveToEeprom();
+bool calibrationSaveToEeprom();
 void calibrationServiceFSM(uint32_t nowMs, bool button24Low);
 
 // Getters inline rapides
@@ -55,20 +74,25 @@ inline uint16_t calibHigh(uint8_t m, uint8_t c) {
 	return gThHigh[m][c];
 }
 inline uint16_t calibRelease(uint8_t m, uint8_t c) {
-	// Release est positionné entre High et Low, en s'écartant de High de max(min, pct*|High-Low|)
-	int h = (int)gThHigh[m][c];
-	int l = (int)gThLow[m][c];
-	int D = abs(h - l);
-	int relFromPct = (int)(CalibCfg::kReleaseDeltaPct * (float)D);
-	int offset = relFromPct;
-	if (offset < (int)CalibCfg::kReleaseDeltaMin) offset = (int)CalibCfg::kReleaseDeltaMin;
-	int s = (h >= l) ? +1 : -1; // signe de la polarité
-	int rel = h - s * offset;
-	if (rel < 0) rel = 0;
-	if (rel > 1023) rel = 1023;
-	return (uint16_t)rel;
+	return gThRelease[m][c];
 }
 
+// Marge d'une touche: k * sigma si le bruit est connu, bornée par la marge en pourcentage
+// historique max(min, pct * D) qui reste la valeur utilisée tant que sigma est inconnu.
+inline int calibNoiseMargin(uint8_t m, uint8_t c, uint8_t kSigma, float pct, uint16_t minCounts, int D) {
+	int limit = (int)(pct * (float)D);
+	if (limit < (int)minCounts) limit = (int)minCounts;
+	const uint8_t sq4 = gNoiseSigmaQ4[m][c];
+	if (!CalibCfg::kNoiseAdaptive || sq4 == 0) return limit;
+	int margin = ((int)kSigma * (int)sq4 + 8) >> 4;
+	if (margin < (int)CalibCfg::kNoiseMarginMin) margin = (int)CalibCfg::kNoiseMarginMin;
+	return (margin < limit) ? margin : limit;
+}
+
+// Release entre High et Low, à une marge de High (bruit ou pourcentage de |High-Low|)
+void calibUpdateRelease(uint8_t m, uint8_t c);
+void calibUpdateAllReleases();
+
 // Compat (si ancien code appelle encore ces noms globaux)
 inline uint16_t getThresholdLow() { return calibLow(0,0); }
 
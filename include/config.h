@@ -86,6 +86,32 @@ static constexpr uint8_t kAdcResolution = 10; // 10-bit ADC (0-1023)
 // MIDI Configuration
 static constexpr uint8_t kMidiChannel = 1; // MIDI channel (1-16)
 
+// Janko: la même hauteur apparaît sur plusieurs rangées. Les notes sont comptées par
+// (canal, hauteur); seul le premier appui envoie NoteOn et seul le dernier relâché envoie NoteOff.
+// Politique quand une hauteur déjà tenue est rejouée depuis une autre touche:
+//   0 = Ignore    : rien n'est envoyé (la voix en cours continue)
+//   1 = Retrigger : NoteOff puis NoteOn avec la nouvelle vélocité
+#ifndef NOTE_RETRIGGER_POLICY
+#define NOTE_RETRIGGER_POLICY 1
+#endif
+
+// MPE (MIDI Polyphonic Expression), zone basse: chaque note reçoit son propre canal membre
+// (allocation LRU avec vol de voix), pression par note = enfoncement de la touche tenue,
+// CC74 par note = profil de frappe (64 = vitesse constante, ou seuil médian non échantillonné:
+// frappe trop rapide, re-press depuis une vallée au-delà du milieu). Le seuil médian est
+// chronométré en MPE même si kVelocityThreePoint = false. Les zones/layers sont ignorés.
+#ifndef MIDI_MPE_MODE
+#define MIDI_MPE_MODE 0
+#endif
+static constexpr bool     kMpeMode = (MIDI_MPE_MODE != 0);
+static constexpr uint8_t  kMpeMasterChannel = 1;   // canal maître de la zone basse
+static constexpr uint8_t  kMpeMemberCount = 15;    // canaux membres 2..16
+static constexpr uint8_t  kMpeTimbreCC = 74;       // CC "timbre" MPE (profil de frappe)
+// Pression par note (touche HELD): au plus une mise à jour par touche toutes les
+// kPressureIntervalUs, et seulement si la valeur a bougé d'au moins kPressureMinStep
+static constexpr uint32_t kPressureIntervalUs = 4000;
+static constexpr uint8_t  kPressureMinStep = 2;
+
 // Scanning Configuration - Target 2 synchronized pairs optimization
 // Base interval entre deux channels (si kContinuousScan == false). Peut descendre à 0.
 static constexpr uint32_t kScanIntervalMicros = 0;   // 1µs par channel (peut être mis à 0)
@@ -98,6 +124,9 @@ static constexpr uint32_t kPerPairDelayMicros = 0;   // Délai en microsecondes
 // Délai ultra-fin en CYCLES CPU (Teensy 4.1 @600 MHz ⇒ 1 µs ≈ 600 cycles). Permet <1 µs.
 // Utilisé uniquement si kPerPairDelayMicros == 0 et kPerPairDelayCycles > 0.
 static constexpr uint32_t kPerPairDelayCycles = 150;   // Exemple: 120 (~0.2 µs), 300 (~0.5 µs), 600 (~1.0 µs)
+// Copies runtime (réglables par SysEx, définies dans main.cpp), initialisées depuis les constantes
+extern uint32_t gScanSettleMicros;
+extern uint32_t gScanPairDelayCycles;
 // Mode scan continu : ignore kScanIntervalMicros et enchaîne les channels sans attente active.
 static constexpr bool kContinuousScan = true;       // Passer à true pour pousser au maximum
 // Objectif théorique de fréquence frawme (informative seulement)
@@ -128,6 +157,57 @@ static constexpr uint16_t kDuplicateTolerance = 1;
 #ifndef DEBUG_FRAME_RATE_TOGGLE_LED
 #define DEBUG_FRAME_RATE_TOGGLE_LED 0  // 1 = toggle LED à chaque frame (diagnostic scope)
 #endif
+// === Latence constante (sortie MIDI sans gigue) ===
+// 0 = off (envoi au plus tôt). Sinon chaque note part à détection + offset (µs), émise par un
+// IntervalTimer de période kConstLatencyTickUs: gigue ≈ tick + polling USB (microframe 125 µs).
+// L'offset doit couvrir le pire chemin détection → file (balayage + service du bus).
+#ifndef MIDI_CONSTANT_LATENCY_US
+#define MIDI_CONSTANT_LATENCY_US 0
+#endif
+static constexpr uint32_t kConstLatencyOffsetUs = MIDI_CONSTANT_LATENCY_US;
+static constexpr uint32_t kConstLatencyTickUs = 20;
+// === Vidage MIDI par interruption logicielle ===
+// 0 = la boucle appelle MidiOut::service() (au plus un envoi par microframe)
+// 1 = chaque enqueue lève une interruption logicielle (EventResponder) qui vide la file
+//     aussitôt, hors fenêtres de conversion ADC et hors distribution d'un lot d'événements
+#ifndef MIDI_DRAIN_ISR
+#define MIDI_DRAIN_ISR 0
+#endif
+static constexpr uint32_t kMidiDrainBudgetUs = 50;   // temps max d'écriture par interruption
+// === Sortie MIDI DIN (UART 31250 bauds, second backend de MidiOut) ===
+#ifndef MIDI_DIN_ENABLE
+#define MIDI_DIN_ENABLE 0
+#endif
+static constexpr bool     kMidiDinEnabled = (MIDI_DIN_ENABLE != 0);
+#define kMidiDinSerial Serial1                                 // TX1 = pin 1
+static constexpr uint16_t kDinQueueSize = 256;                 // notes en attente (~0.25 s de ligne)
+static constexpr uint32_t kDinContMinGapUs = 5000;             // ≤ 200 messages continus/s (~20% ligne)
+static constexpr uint32_t kDinRunningStatusRefreshMs = 300;    // ré-émission périodique du statut
+static constexpr bool     kDinNoteOffAsZeroVelocity = true;    // NoteOff = NoteOn vel 0 (running status)
+static constexpr uint8_t  kDinChordWindow = 8;                 // NoteOn consécutifs triés par vélocité
+// === MIDI writer statistics (paquets USB, événements/paquet, latence file → USB) ===
+#ifndef DEBUG_MIDI_STATS
+#define DEBUG_MIDI_STATS 0
+#endif
+#ifndef DEBUG_MIDI_STATS_INTERVAL_MS
+#define DEBUG_MIDI_STATS_INTERVAL_MS 1000
+#endif
+// === Temps de boucle (pire cas de loop() par intervalle, utile pendant la calibration) ===
+#ifndef DEBUG_LOOP_TIME
+#define DEBUG_LOOP_TIME 0
+#endif
+#ifndef DEBUG_LOOP_TIME_INTERVAL_MS
+#define DEBUG_LOOP_TIME_INTERVAL_MS 1000
+#endif
+// Sauvegarde EEPROM en tâche de fond: octets écrits (différents) et lus pour comparaison par
+// tour de loop(). Chaque EEPROM.read/write parcourt le journal d'un secteur flash (~µs): la
+// comparaison se fait contre une copie RAM de l'emplacement cible, les lectures ne servent
+// qu'aux octets encore inconnus (premier commit dans un emplacement après le boot).
+static constexpr uint16_t kEepromBytesPerLoop = 2;
+static constexpr uint16_t kEepromComparesPerLoop = 4;
+#ifndef DEBUG_EEPROM_STATS
+#define DEBUG_EEPROM_STATS 0   // 1 = compteurs d'écriture imprimés à chaque commit
+#endif
 // === Debug Options ===
 // Freeze scanning to a fixed logical channel (0..15). Set to -1 for normal operation.
 // Set to 6 to freeze scanning on logical channel 6 for debug logging
@@ -179,6 +259,29 @@ static constexpr uint8_t kLedBrightness = 120;
 // Double-click encoder button to save to EEPROM; triple-click to reset to 0.20f.
 static constexpr float kVelocityGammaDefault = 0.20f;
 
+// === Linéarisation de la course ===
+// true: la vitesse est calculée en course physique (µm/µs) via la table ADC→course par touche
+// (TravelMap, construite en Phase2), au lieu de delta ADC / dt.
+// Désactivé par défaut: la table vient d'un modèle dipolaire fixe (kHallQuiescent, kFieldExponent),
+// pas d'un ajustement aux échantillons du balayage Phase2; à valider sur l'instrument (capteur,
+// aimant, entrefer réels) avant de l'activer.
+static constexpr bool kVelocityUseTravel = false;
+
+// === Vélocité 3 points (Low → Mid → High) ===
+// true: un seuil intermédiaire (Low+High)/2 découpe la frappe en deux segments chronométrés;
+// la vitesse finale pondère le second segment (kThreePointLateWeight) pour refléter la vitesse
+// en fin de course et ignorer un départ lent suivi d'un coup sec. Repli 2 points si le seuil
+// médian n'a pas été échantillonné entre le départ et le déclenchement.
+// Désactivé par défaut tant que le gain n'est pas mesuré: comparer les deux chemins avec
+// DEBUG_VELOCITY_COMPARE sur l'instrument ou test/test_velocity_replay en natif.
+static constexpr bool  kVelocityThreePoint = false;
+static constexpr float kThreePointLateWeight = 0.75f;
+// Replay/benchmark: capture à chaque NoteOn la vélocité 2 points, 3 points et le profil,
+// imprimés depuis loop() (jamais de Serial dans le scan)
+#ifndef DEBUG_VELOCITY_COMPARE
+#define DEBUG_VELOCITY_COMPARE 0
+#endif
+
 // === Re-press detection (ThresholdMed) ===
 // Quand une touche est relâchée (sous ThresholdRelease) mais ne revient pas jusqu'à ThresholdLow,
 // on tracke la "vallée" (minimum) et, si la touche repart, on démarre le timing depuis cette vallée.
@@ -190,6 +293,58 @@ static constexpr uint8_t  kRepressStableCount = 1; // passer à 2 si besoin de p
 // Ex: 0.20f = la touche doit retomber d'au moins 20% de sa course avant de pouvoir être re-déclenchée
 static constexpr float    kRepressMinReturnPct = 0.40f;
 
+// === Suivi de dérive du repos (BaselineTracker) ===
+static constexpr bool     kBaselineTracking      = true;
+static constexpr uint32_t kDriftVisitUs          = 1000;   // une visite toutes les 1 ms...
+static constexpr uint8_t  kDriftKeysPerVisit     = 8;      // ...de 8 touches → chaque touche ~60 fois/s
+static constexpr uint8_t  kDriftMinIdleObs       = 32;     // ~0.5 s IDLE avant d'utiliser les échantillons
+static constexpr uint16_t kDriftMinMarginCounts  = 4;      // ancrage: échantillon à ≥ 4 counts côté repos de Low
+static constexpr uint16_t kDriftOutlierCounts    = 6;      // |v - repos| au-delà: échantillon rejeté
+static constexpr uint8_t  kDriftAlphaShift       = 10;     // EMA 1/1024 par observation (τ ≈ 17 s)
+static constexpr uint32_t kDriftStepMs           = 2000;   // Low bouge d'au plus 1 count par touche et par pas
+static constexpr uint32_t kDriftPersistMs        = 600000; // sauvegarde au plus toutes les 10 min
+
+// === Santé des capteurs (KeyHealth) ===
+static constexpr bool     kHealthMonitor         = true;
+static constexpr uint16_t kHealthBootFrames      = 128;    // fenêtre de contrôle au boot (quelques dizaines de ms)
+static constexpr uint16_t kHealthBootSpanCounts  = 40;     // max-min au repos au-delà: bruyant
+static constexpr uint16_t kHealthRailCounts      = 4;      // <= 4 ou >= 1019: rail
+static constexpr uint32_t kHealthVisitUs         = 1000;
+static constexpr uint8_t  kHealthKeysPerVisit    = 8;      // chaque touche ~60 fois/s
+static constexpr uint16_t kHealthBadObs          = 60;     // ~1 s au rail avant exclusion
+static constexpr uint16_t kHealthFrozenObs       = 3600;   // ~60 s sans le moindre LSB de bruit
+static constexpr uint8_t  kHealthMaxSigmaQ4      = 96;     // sigma > 6 counts: trop bruyant
+static constexpr uint16_t kHealthRecoverObs      = 600;    // ~10 s sans défaut avant réintégration
+static constexpr uint16_t kHealthProbeFrames     = 256;    // channel mort rescanné 1 frame sur 256
+// Défauts qui excluent la touche (Frozen seul est signalé: un capteur très calme peut être figé)
+static constexpr uint8_t  kHealthExcludeMask     = 0x0D;   // OutOfRange | Noisy | Swing
+
+#ifndef DEBUG_HEALTH_REPORT
+#define DEBUG_HEALTH_REPORT 0      // 1 = rapport série périodique + à chaque changement
+#endif
+#ifndef DEBUG_HEALTH_REPORT_INTERVAL_MS
+#define DEBUG_HEALTH_REPORT_INTERVAL_MS 5000
+#endif
+
+// === Compensation en température (TempComp, tempmon de la puce) ===
+static constexpr bool     kTempCompensation      = true;
+static constexpr uint32_t kTempSampleMs          = 1000;   // lecture tempmon 1 Hz
+static constexpr uint8_t  kTempFilterShift       = 3;      // EMA 1/8 sur la température
+static constexpr uint32_t kTempLearnMs           = 10000;  // un point de régression par touche toutes les 10 s
+static constexpr uint16_t kTempMaxObs            = 1024;   // au-delà: sommes divisées par 2 (oubli)
+static constexpr float    kTempMinSpanC          = 3.0f;   // écart-type mini de T avant d'appliquer une pente
+static constexpr float    kTempMaxSlope          = 4.0f;   // |pente| plausible max (counts/°C)
+static constexpr uint32_t kTempApplyMs           = 2000;   // cadence d'application des corrections
+static constexpr uint8_t  kTempMaxStepCounts     = 1;      // décalage max par touche et par passe
+
+// Journal CSV pour ajuster le modèle hors ligne
+#ifndef DEBUG_TEMP_LOG
+#define DEBUG_TEMP_LOG 0
+#endif
+#ifndef DEBUG_TEMP_LOG_INTERVAL_MS
+#define DEBUG_TEMP_LOG_INTERVAL_MS 10000
+#endif
+
 // === Calibration relative (pourcentages globaux) ===
 // Ces constantes pilotent l'adaptation des seuils par touche à partir des valeurs brutes Low/High.
 // Elles remplacent les marges absolues et s'appliquent en proportion de D = |High - Low|.
@@ -205,5 +360,23 @@ namespace CalibCfg {
     // Release: Release = High ∓ max(Min, Pct * D)
     constexpr float    kReleaseDeltaPct     = 0.15f;  // 15%
     constexpr uint16_t kReleaseDeltaMin     = 10;
+
+    // Marges adaptées au bruit: marge = k * sigma(repos), bornée par [kNoiseMarginMin, max(Min, Pct * D)].
+    // Sigma inconnu (boot, < kNoiseMinObs observations) → marges en pourcentage ci-dessus.
+    constexpr bool     kNoiseAdaptive       = true;
+    constexpr uint8_t  kLowSigmaK           = 5;
+    constexpr uint8_t  kHighSigmaK          = 6;
+    constexpr uint8_t  kReleaseSigmaK       = 6;
+    constexpr uint16_t kNoiseMarginMin      = 4;      // plancher absolu (quantification ADC)
+    constexpr uint16_t kNoiseMinObs         = 256;    // ~4 s de repos avant de faire confiance à sigma
+    constexpr uint8_t  kNoiseMadShift       = 6;      // EMA 1/64 de |v - repos|
 }
 
+// Rapport périodique du bruit de repos par touche (grille 8 x 16, sigma en centièmes de count)
+#ifndef DEBUG_NOISE_REPORT
+#define DEBUG_NOISE_REPORT 0
+#endif
+#ifndef DEBUG_NOISE_REPORT_INTERVAL_MS
+#define DEBUG_NOISE_REPORT_INTERVAL_MS 10000
+#endif
+
@@ -2,11 +2,64 @@
 #include <Arduino.h>
 #include "config.h"
 
+// Stockage EEPROM (émulée en flash sur Teensy 4).
+// La configuration (seuils, gamma, courbes, layout) est un enregistrement TLV versionné: une
+// liste de sections { tag, version, longueur, données }. Tag inconnu ignoré, section absente =
+// valeurs par défaut: ajouter une section n'invalide plus la calibration. L'enregistrement est
+// lu et vérifié (CRC32 par table) une seule fois au boot, directement dans son image RAM; les
+// anciens formats (bloc v2, blocs séparés) y sont migrés. Chaque enregistrement a deux
+// emplacements A/B avec une génération. Une sauvegarde met à jour l'image puis le moteur de
+// commit écrit, depuis loop(), uniquement les octets qui diffèrent dans l'emplacement inactif,
+// quelques-uns par appel, l'en-tête en dernier: l'ancien emplacement reste valide jusqu'à la bascule.
 namespace EepromStore {
-    // Load per-key Low/High and velocity gamma from EEPROM; returns true if valid CRC and version.
-    // If gamma is nullptr, it is not loaded.
+    // Read + verify the config record once (migrating older layouts); implicit on first use
+    void begin();
+
+    enum class Section : uint8_t { Thresholds = 1, Gamma = 2, Curves = 3, Layout = 4 };
+    // Layout version of a stored section, 0 if absent
+    uint8_t sectionVersion(Section tag);
+    // Copy a section into data (at most len bytes); returns the bytes copied, 0 if absent or if
+    // it was stored with another layout version (a newer one is skipped, an older one is left to
+    // the caller to migrate). A shorter stored section leaves the remaining bytes of data untouched.
+    size_t loadSection(Section tag, void* data, size_t len, uint8_t version = 1);
+    // Update a section (with its layout version) in the config image and queue the record
+    // for the background writer
+    bool saveSection(Section tag, const void* data, size_t len, uint8_t version = 1);
+
+    // Per-key Low/High (+ velocity gamma if not nullptr) from the config sections;
+    // returns false if no thresholds are stored.
     bool load(uint16_t low[N_MUX][N_CH], uint16_t high[N_MUX][N_CH], float* gamma = nullptr);
-    // Save per-key Low/High and velocity gamma to EEPROM (overwrites previous contents).
-    // If gamma is nullptr, current value is preserved or defaults to kVelocityGammaDefault.
-    void save(const uint16_t low[N_MUX][N_CH], const uint16_t high[N_MUX][N_CH], const float* gamma = nullptr);
+    // Per-key travel map ends (rest, peak) stored with the thresholds; false if absent
+    // (record written before they were kept)
+    bool loadTravel(uint16_t rest[N_MUX][N_CH], uint16_t peak[N_MUX][N_CH]);
+
+    // Snapshot per-key Low/High, travel rest/peak and velocity gamma (gamma section untouched
+    // if nullptr); written in the background by service(). A newer snapshot replaces a pending one.
+    bool beginSave(const uint16_t low[N_MUX][N_CH], const uint16_t high[N_MUX][N_CH],
+                   const uint16_t rest[N_MUX][N_CH], const uint16_t peak[N_MUX][N_CH],
+                   const float* gamma = nullptr);
+    // true while any snapshot is not yet committed
+    bool saveBusy();
+    // Diff the pending record against a RAM copy of the target slot (at most
+    // kEepromComparesPerLoop EEPROM reads where that copy is unknown) and write at most
+    // maxBytes changed bytes (call every loop iteration)
+    void service(uint16_t maxBytes);
+
+    // Write counters since boot
+    struct Stats {
+        uint32_t commits;           // completed A/B switches
+        uint32_t bytesWritten;      // bytes that differed (flash writes)
+        uint32_t bytesUnchanged;    // bytes skipped by the diff
+        uint32_t restarts;          // snapshots replaced while being written
+        uint16_t lastCommitWritten; // bytes written by the last commit
+        uint32_t maxServiceUs;      // worst time spent in one service() call
+    };
+    void getStats(Stats& out);
+
+    // Learned data kept outside the config record (own A/B slots, header + CRC32)
+    enum class Block : uint8_t { SpeedEq = 0 };
+    // Load a block into data (exactly len bytes); returns false if absent, wrong size or bad CRC.
+    bool loadBlock(Block id, void* data, size_t len);
+    // Snapshot a block for the background writer (len must fit its slot); false if too large.
+    bool saveBlock(Block id, const void* data, size_t len);
 }
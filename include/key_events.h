@@ -0,0 +1,47 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// === Key event bus ===
+// processKey() publie des événements compacts horodatés dans un anneau SPSC sans verrou.
+// Les abonnés (MIDI, LEDs, logger, synthé...) sont servis hors du scan par service():
+// le scan ne bloque jamais sur une sortie, et ajouter une sortie ne coûte rien au hot path.
+namespace KeyEvents {
+    enum class Kind : uint8_t { Press = 0, Release = 1, Pressure = 2 };
+
+    struct KeyEvent {
+        uint8_t  key;      // index touche = mux * N_CH + channel
+        Kind     kind;
+        uint8_t  velocity; // 1..127 pour Press, 0 pour Release/Pressure
+        uint8_t  value;    // Press: profil de frappe (64 = vitesse constante, >64 accélération)
+                           // Pressure: enfoncement de la touche tenue 0..127
+        uint32_t t_us;     // horodatage de détection (micros)
+    };
+    static_assert(sizeof(KeyEvent) == 8, "KeyEvent must stay compact");
+
+    // Abonné: retourne false s'il ne peut pas accepter l'événement maintenant.
+    // L'événement reste alors en tête de file et lui sera re-proposé au prochain service()
+    // (les abonnés l'ayant déjà accepté ne le revoient pas).
+    using Subscriber = bool (*)(const KeyEvent& ev);
+    constexpr uint8_t kMaxSubscribers = 4;
+
+    void init();
+    // Enregistre un abonné (setup uniquement). Retourne false si la table est pleine.
+    bool subscribe(Subscriber fn);
+
+    // Producteur (scan): non bloquant, O(1). Retourne false si l'anneau est plein.
+    // Une partie de l'anneau est réservée aux Release: une Release n'est jamais perdue
+    // (Press/Pressure sont refusés avant que la réserve soit entamée). La Release d'une touche
+    // dont le Press a été refusé n'est pas publiée (false): aucune note ne sonne.
+    bool publish(const KeyEvent& ev);
+
+    // Consommateur (hors scan): distribue au plus maxEvents événements à tous les abonnés
+    void service(uint16_t maxEvents);
+
+    // Événements perdus faute de place dans l'anneau (diagnostic)
+    uint32_t droppedCount();
+
+    inline uint8_t keyIndex(uint8_t mux, uint8_t channel) { return (uint8_t)(mux * N_CH + channel); }
+    inline uint8_t keyMux(uint8_t key) { return (uint8_t)(key / N_CH); }
+    inline uint8_t keyChannel(uint8_t key) { return (uint8_t)(key % N_CH); }
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// === Santé des capteurs ===
+// Détecte les capteurs hors plage (rail), figés, trop bruyants ou à course implausible,
+// au boot (fenêtre de kHealthBootFrames frames sans jeu attendu) puis en tâche de fond
+// (quelques touches par ms, comme BaselineTracker). Une touche exclue ne passe plus par la
+// FSM (bande de repos « toujours calme ») et un channel dont les 8 touches sont exclues
+// sort du plan de scan, hormis une frame de sonde toutes les kHealthProbeFrames pour
+// permettre la guérison. Rapport série via DEBUG_HEALTH_REPORT.
+namespace KeyHealth {
+    enum Flag : uint8_t {
+        OutOfRange = 1 << 0,  // lecture collée à un rail (entrée MUX flottante/court-circuit)
+        Frozen     = 1 << 1,  // valeur strictement identique depuis kHealthFrozenObs observations
+        Noisy      = 1 << 2,  // bruit de repos au-delà de kHealthMaxSigmaQ4 / étendue au boot
+        Swing      = 1 << 3,  // course implausible (High≈Low) ou lecture « enfoncée » au repos (seuils calibrés)
+    };
+
+    void init();
+    // Fenêtre de boot: à appeler à chaque fin de frame tant que bootCheckActive()
+    bool bootCheckActive();
+    void frameIngest(const uint16_t frameValues[N_MUX][N_CH]);
+    // Contrôle de fond (rythmé par kHealthVisitUs)
+    void service(uint32_t nowUs);
+
+    // Plan de scan: channel suivant après 'current' (saute les channels morts)
+    uint8_t nextScanChannel(uint8_t current);
+
+    uint8_t flags(uint8_t mux, uint8_t ch);
+    bool excluded(uint8_t mux, uint8_t ch);
+    uint8_t excludedCount();
+    void printReport();
+}
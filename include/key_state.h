@@ -35,6 +35,17 @@ struct KeyData {
     // Peak tracking pour adaptation High dynamique
     uint16_t peak_adc = 0;
 
+    // Three-point velocity: crossing of the intermediate threshold (thLow+thHigh)/2
+    bool     mid_seen = false;
+    uint16_t adc_mid = 0;
+    uint32_t t_mid_us = 0;
+    // Stroke profile of the last NoteOn: 64 = constant speed (or mid not timed), >64
+    // accelerating, <64 slowing. Measured with three-point velocity or in MPE mode (CC74)
+    uint8_t  stroke_profile = 64;
+    // Per-note pressure while HELD (MPE): last published value and its timestamp
+    uint8_t  pressure = 0;
+    uint32_t t_pressure_us = 0;
+
     // Re-press valley tracking (ThresholdMed):
     // When key transitions HELD → REARMED (released but not fully), we start tracking
     // the lowest ADC reached before the next press. If the next press occurs before
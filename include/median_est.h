@@ -0,0 +1,54 @@
+#pragma once
+#include <stdint.h>
+
+// === Médiane en flux (Frugal-2U) ===
+// 4 octets par touche au lieu d'un histogramme 1024 bins: l'estimation monte/descend vers
+// chaque échantillon avec un pas qui grandit tant que le sens se répète (convergence rapide
+// depuis un mauvais départ) et retombe à 1 au changement de sens (stabilité autour de la
+// médiane). Travail O(1) par échantillon, aucune allocation. Sans dépendance Arduino: testé
+// en natif contre la médiane exacte (test/test_median).
+struct MedianEst {
+	uint16_t m;    // estimation courante
+	int8_t   step; // pas adaptatif
+	int8_t   sign; // sens de la dernière mise à jour (+1 / -1)
+};
+static_assert(sizeof(MedianEst) == 4, "MedianEst must stay 4 bytes");
+
+// Départ sur le premier échantillon
+inline void medianStart(MedianEst& e, uint16_t s) {
+	e.m = s; e.step = 1; e.sign = 1;
+}
+
+inline void medianUpdate(MedianEst& e, uint16_t s) {
+	int m = e.m;
+	int step = e.step;
+	if (s > m) {
+		step += (e.sign > 0) ? 1 : -1;
+		m += (step > 0) ? step : 1;
+		if (m > s) { step += (int)s - m; m = s; }
+		if (e.sign < 0 && step > 1) step = 1;
+		e.sign = 1;
+	} else if (s < m) {
+		step += (e.sign < 0) ? 1 : -1;
+		m -= (step > 0) ? step : 1;
+		if (m < s) { step += m - (int)s; m = s; }
+		if (e.sign > 0 && step > 1) step = 1;
+		e.sign = -1;
+	} else {
+		return;
+	}
+	if (step > 64) step = 64;
+	if (step < -64) step = -64;
+	e.m = (uint16_t)m;
+	e.step = (int8_t)step;
+}
+
+// Moyenne glissante (Q4, 1/32) de l'estimation: lisse la marche aléatoire de ±pas autour de
+// la médiane vraie. Initialiser à m << 4 avec medianStart.
+inline void medianSmooth(uint16_t& smoothQ4, const MedianEst& e) {
+	int sm = smoothQ4;
+	sm += (((int)e.m << 4) - sm) / 32;
+	smoothQ4 = (uint16_t)sm;
+}
+
+inline uint16_t medianSmoothed(uint16_t smoothQ4) { return (uint16_t)((smoothQ4 + 8) >> 4); }
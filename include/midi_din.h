@@ -0,0 +1,46 @@
+#pragma once
+#include <Arduino.h>
+#include "midi_out.h"
+
+// === Sortie MIDI DIN (UART 31250 bauds) ===
+// Second backend de MidiOut, servi indépendamment de l'USB: une ligne DIN lente ne retarde
+// jamais la sortie USB. ~3125 octets/s ≈ 1000 messages de 3 octets/s, d'où:
+//  - notes: file dédiée, jamais amincies; les NoteOff ne sont jamais perdus (débordement
+//    reporté dans un bitmap, réinjecté dans la file avant tout événement plus récent);
+//    un accord part dans l'ordre des vélocités décroissantes;
+//  - données continues: coalescées (dernière valeur par contrôleur) puis amincies
+//    (au plus une toutes les kDinContMinGapUs, et seulement quand aucune note n'attend);
+//  - running status: l'octet de statut n'est répété que s'il change (NoteOff envoyés en
+//    NoteOn vélocité 0 pour prolonger le running status).
+// L'UART est abstraite par un ByteSink: en build hôte, un faux UART capture les octets.
+namespace MidiDin {
+    struct ByteSink {
+        int  (*availableForWrite)();   // octets acceptés sans bloquer
+        void (*write)(uint8_t b);
+    };
+
+    struct Stats {
+        uint32_t bytes;             // octets écrits sur la ligne
+        uint32_t messages;          // messages complets écrits
+        uint32_t runningStatusSaved;// octets de statut économisés
+        uint32_t contThinned;       // valeurs continues remplacées avant émission
+        uint32_t noteOnDropped;     // NoteOn (ou événements ordonnés) perdus: file pleine
+        uint32_t noteOffDeferred;   // NoteOff passés par le bitmap de débordement
+        uint16_t queueHighWater;
+    };
+
+    // Ouvre l'UART par défaut (Serial1) si aucun sink n'a été fourni
+    void init();
+    // Remplace la sortie (build hôte / test); nullptr-safe: un sink vide coupe la sortie
+    void setSink(const ByteSink& sink);
+
+    // Appelé par MidiOut pour chaque événement, quel que soit son sort côté USB (boucle principale)
+    void enqueue(const MidiOut::Event& ev);
+    // Événement ordonné avec les notes (MidiOut::enqueueInOrder): file FIFO, jamais coalescé
+    void enqueueInOrder(const MidiOut::Event& ev);
+
+    // Écrit ce que la ligne accepte sans bloquer (appeler à chaque tour de boucle)
+    void service();
+
+    void takeStats(Stats& out);
+}
@@ -1,22 +1,89 @@
 #pragma once
 #include <Arduino.h>
 
+// === MIDI output queue ===
+// Deux classes de trafic:
+//  - notes (NoteOn/NoteOff): anneau SPSC, jamais écrasées, toujours envoyées en premier.
+//    Aucun événement n'est refusé au producteur (le DIN, alimenté par les mêmes appels, ne doit
+//    pas attendre l'USB): anneau plein = NoteOff reporté (bitmap réinjecté avant tout événement
+//    plus récent), autre événement perdu et compté;
+//  - données continues (CC, pression): table de coalescence, une entrée par
+//    (canal, contrôleur): la dernière valeur gagne, un flot de CC ne retarde jamais un NoteOn.
+// Mode latence constante (optionnel): chaque note est horodatée à la détection et n'est émise
+// qu'à détection + offset, par un ordonnanceur sur IntervalTimer. La latence ne dépend plus de
+// la position de la touche dans le balayage ni du moment où la boucle sert la file. Les données
+// continues sont retenues du même offset (depuis leur plus ancienne valeur non envoyée): une
+// pression MPE ne devance jamais son NoteOn.
 namespace MidiOut {
-    enum class Kind : uint8_t { NoteOn = 0, NoteOff = 1, CC = 2 };
+    enum class Kind : uint8_t { NoteOn = 0, NoteOff = 1, CC = 2, ChannelPressure = 3 };
 
     struct Event {
         Kind kind;
         uint8_t ch;   // MIDI channel 1..16
-        uint8_t d1;   // note or CC number
+        uint8_t d1;   // note, CC number or pressure
         uint8_t d2;   // velocity or CC value
     };
 
-    // Initialize (placeholder for future backends)
+    // Writer and queue statistics since the last takeStats()
+    struct Stats {
+        uint32_t packets;        // flushes (send_now) = USB transfers
+        uint32_t events;         // events written
+        uint16_t maxPerPacket;   // largest batch in a single flush
+        uint32_t latencySumUs;   // sum of timestamp → flush delays (detection time when provided)
+        uint32_t latencyMinUs;   // best timestamp → flush delay (max - min = output jitter)
+        uint32_t latencyMaxUs;   // worst timestamp → flush delay
+        uint32_t late;           // constant-latency mode: events sent after their due tick
+        uint16_t noteHighWater;  // max occupancy of the note ring
+        uint8_t  contHighWater;  // max pending continuous entries
+        uint32_t coalesced;      // continuous values overwritten before being sent
+        uint32_t contDropped;    // continuous values lost (coalescing table full)
+        uint32_t noteDropped;    // ring full: NoteOn / ordered events lost
+        uint32_t noteOffDeferred;// ring full: NoteOffs passed through the overflow bitmap
+        uint32_t txDropped;      // events discarded by the writer: no USB host configured (or, when
+                                 // written from an interrupt, a host not reading for 20 ms)
+    };
+
+    // Initialize writer state (flush scheduling, statistics)
     void init();
 
-    // Non-blocking enqueue (returns false if queue full)
-    bool enqueue(const Event& ev);
+    // Non-blocking enqueue, never to be retried: DIN always takes the event (own queue), USB puts
+    // notes in the ring and coalesces continuous kinds. false = not queued for USB (NoteOff
+    // deferred, other event dropped, or coalescing table full). t_us: reference timestamp of the
+    // event (detection time), used for scheduling and latency.
+    bool enqueue(const Event& ev, uint32_t t_us = micros());
+
+    // Force any kind into the note ring, ordered with the notes. For per-note state that
+    // must precede its NoteOn (MPE timbre/pressure reset) or ordered sequences (RPN).
+    // Supersedes a pending coalesced value for the same controller.
+    bool enqueueInOrder(const Event& ev, uint32_t t_us = micros());
+
+    // Lowest priority: one SysEx message (F0 ... F7, at most kSysexMax bytes) in a single slot,
+    // written only once the note ring is empty. Returns false while the slot is still busy.
+    constexpr uint16_t kSysexMax = 96;
+    bool sendSysEx(const uint8_t* data, uint16_t len);
 
-    // Drain queue for up to budgetUs microseconds (non-blocking overall)
+    // Batched writer: call every loop iteration. At most one flush per USB high-speed
+    // microframe (125 µs): everything pending is packed into the current USB-MIDI transfer
+    // and sent with a single send_now(), so a chord leaves in one packet. Without SOFs (no
+    // host, suspended) the microframe counter stops and the writer drains every millisecond.
+    // budgetUs bounds the time spent writing in one call.
+    // No-op in constant-latency mode (the timer ISR owns USB writes). In interrupt drain mode
+    // (MIDI_DRAIN_ISR) it only re-triggers the drain if work was left over by its budget or
+    // deferred while the core's TX buffers were busy.
     void service(uint32_t budgetUs);
+
+    // Interrupt drain mode: windows during which the drain must not run (ADC conversions,
+    // dispatch of a batch of key events so a chord leaves in one transfer). Nestable;
+    // a drain requested inside the window fires at the closing resumeDrain().
+    void deferDrain();
+    void resumeDrain();
+
+    // Constant-latency mode: notes leave at detection + offsetUs (0 = off, back to service()).
+    // All USB writes then happen in the scheduler ISR only, and only while the core has free TX
+    // buffers (a usbMIDI write that would wait is deferred to a later tick).
+    void setConstantLatency(uint32_t offsetUs);
+    uint32_t constantLatency();
+
+    // Copy and reset the statistics
+    void takeStats(Stats& out);
 }
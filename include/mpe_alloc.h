@@ -0,0 +1,26 @@
+#pragma once
+#include <Arduino.h>
+
+// === Allocateur de canaux membres MPE ===
+// Deux listes doublement chaînées sur un tableau fixe de canaux:
+//  - libres, dans l'ordre de libération: on réattribue le canal libéré le plus anciennement
+//    (sa queue de release a eu le plus de temps pour s'éteindre côté synthé);
+//  - occupés, dans l'ordre d'attribution: si tout est pris, on vole la note la plus ancienne.
+// allocate() et release() sont O(1) quel que soit le nombre de notes tenues.
+namespace MpeAlloc {
+    constexpr uint8_t kMaxChannels = 15;
+    constexpr uint8_t kNone = 0xFF;
+
+    // Canaux membres firstCh..firstCh+count-1 (count <= kMaxChannels), tous libres
+    void init(uint8_t firstCh, uint8_t count);
+
+    // Attribue un canal à la touche key. Si un vol a eu lieu, stolenKey reçoit la touche
+    // dépossédée (sinon kNone). Retourne le canal MIDI 1..16.
+    uint8_t allocate(uint8_t key, uint8_t& stolenKey);
+
+    // Rend le canal (ignoré s'il n'est pas attribué)
+    void release(uint8_t ch);
+
+    // Touche propriétaire du canal, kNone si libre
+    uint8_t owner(uint8_t ch);
+}
@@ -3,23 +3,98 @@
 #include "config.h"
 
 // === MIDI Note Mapping for 8x16 MUX Configuration ===
+// Runtime layout engine: the selected layout, its row offsets, the zones and the current
+// transpose are folded into a flat [mux][channel] → outputs table. A new table is generated off the hot path
+// into the inactive buffer and published with a single pointer store; a NoteOn is then one
+// load. Held notes keep the note resolved at Press (NoteOutput), so they release on their
+// original pitch across layout or transpose changes.
 
 // Sentinel value for disabled keys
 constexpr int8_t DISABLED = -1;
 
-// Note mapping table [mux][channel] -> MIDI note (0-127) or DISABLED
-extern const int8_t kNoteMap[8][16];
+// Physical grid: row = MUX, column = MUX channel (8 rows x 16 columns)
+constexpr uint8_t kGridRows = N_MUX;
+constexpr uint8_t kGridCols = N_CH;
 
-// Global transpose value (semitones) applied by effectiveNote
+// Available layouts (isomorphic: note = base + col*colStep + row'*rowStep + transpose,
+// row' = row % rowPeriod when the layout repeats rows, e.g. Janko)
+enum class LayoutKind : uint8_t {
+    Janko = 0,          // whole tone along a row, semitone between rows, rows repeat every 2
+    WickiHayden = 1,    // whole tone along a row, fourth between rows
+    Chromatic = 2,      // semitone along a row, one full row (16) between rows
+    HarmonicTable = 3,  // major third along a row, fifth between rows
+    Count
+};
+
+struct LayoutDef {
+    const char* name;
+    int8_t  base;       // note of row 0 / column 0 before transpose
+    int8_t  colStep;    // semitones per column
+    int8_t  rowStep;    // semitones per row
+    uint8_t rowPeriod;  // 0 = no repetition, else rows repeat every rowPeriod
+};
+
+// === Zones (split / layer) ===
+// Rectangular regions of the grid with their own MIDI channel, transpose and velocity curve,
+// optionally layered onto a second channel. The first zone containing a key wins; keys in no
+// zone play on kMidiChannel with the global transpose only.
+constexpr uint8_t kMaxZones = 4;
+constexpr uint8_t kMaxLayers = 2;         // outputs per key (main + layer)
+constexpr uint8_t kZoneKeepCurve = 0xFF;  // zone does not override the keys' curve
+
+struct Zone {
+    uint8_t row0, col0, row1, col1;  // inclusive corners on the physical grid
+    uint8_t ch;                      // MIDI channel 1..16
+    int8_t  transpose;               // semitones, added to the global transpose
+    uint8_t curve;                   // VelocityCurves index or kZoneKeepCurve
+    uint8_t layerCh;                 // 0 = no layer, else second channel 1..16
+    int8_t  layerTranspose;          // layer transpose relative to the zone note
+};
+
+// Precomputed outputs of a key: a NoteOn is a fixed walk over count entries
+struct NoteOut {
+    uint8_t ch;    // MIDI channel 1..16
+    uint8_t note;  // 0..127 (out-of-range outputs are dropped at generation)
+};
+struct KeyOutputs {
+    uint8_t count;
+    NoteOut out[kMaxLayers];
+    uint8_t curve;  // zone curve resolved at publish, kZoneKeepCurve = the key's own curve
+};
+
+// Active output table (published atomically); never null after noteMapInit()
+extern const KeyOutputs (* volatile gActiveOutputs)[N_CH];
+
+// Global transpose value (semitones) folded into the active table
 extern int8_t gTranspose;
 
-// Setter to update global transpose (from IoState)
+// Load the stored layout (EEPROM) and publish the first table. Call once in setup.
+void noteMapInit();
+
+// Setter to update global transpose (from IoState); regenerates only if it changed
 void noteMapSetTranspose(int8_t semitones);
 
-// Get effective MIDI note for given MUX and channel
+// Select a layout (regenerated and published immediately) / persist the current selection
+bool noteMapSetLayout(LayoutKind kind);
+LayoutKind noteMapLayout();
+const LayoutDef& noteMapLayoutDef(LayoutKind kind);
+bool noteMapSave();
+
+// Replace the zone list (n <= kMaxZones, 0 = single default zone) and republish
+bool noteMapSetZones(const Zone* zones, uint8_t n);
+uint8_t noteMapZones(Zone* out);
+
+// Precomputed outputs of a key (channel + note per layer)
+inline const KeyOutputs& keyOutputs(uint8_t mux, uint8_t channel) {
+    return gActiveOutputs[mux][channel];
+}
+
+// Get effective MIDI note for given MUX and channel (main output)
 // Returns DISABLED if key is disabled or note out of range
-// Note: Transpose will be applied later when controlled by hardware pin
-int8_t effectiveNote(uint8_t mux, uint8_t channel);
+inline int8_t effectiveNote(uint8_t mux, uint8_t channel) {
+    const KeyOutputs& ko = gActiveOutputs[mux][channel];
+    return ko.count ? (int8_t)ko.out[0].note : DISABLED;
+}
 
 // Legacy function for compatibility (will be removed)
 inline uint8_t getMidiNote(uint8_t mux, uint8_t channel) {
@@ -43,18 +118,3 @@ inline uint8_t getNoteOctave(uint8_t midiNote) {
 void printNoteMap();
 
 // Note: hardware pin polling is centralized in IoState (io_state.*)
-
-// === 8-MUX Note Layout for Testing ===
-// Group A (ADC1):
-// MUX0: notes 48-63   (C3 to D#4)
-// MUX1: notes 64-79   (E4 to G5) 
-// MUX2: notes 80-95   (G#5 to B6)
-// MUX3: notes 96-111  (C7 to D#8)
-// 
-// Group B (ADC0):
-// MUX4: notes 112-127 (E8 to G9)
-// MUX5: notes 128-143 (G#9 to B10) - might exceed MIDI range
-// MUX6: notes 144-159 (C11 to D#12) - might exceed MIDI range
-// MUX7: notes 160-175 (E12 to G13) - might exceed MIDI range
-// 
-// Note: MIDI standard goes up to 127, higher notes for testing only
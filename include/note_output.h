@@ -0,0 +1,20 @@
+#pragma once
+#include <Arduino.h>
+#include "key_events.h"
+
+// === Note output (abonné MIDI du bus d'événements touches) ===
+// Résout la note d'une touche au moment du Press et la mémorise pour que le Release
+// parte toujours sur la même note, puis pousse NoteOn/NoteOff dans MidiOut.
+// Les hauteurs sont comptées par (canal, note): en disposition Janko, une même note tenue
+// sur deux rangées n'envoie qu'un NoteOn (ou un retrigger, NOTE_RETRIGGER_POLICY) et le
+// NoteOff ne part qu'au relâchement de la dernière touche.
+// En mode MPE (MIDI_MPE_MODE), chaque note part sur son propre canal membre (MpeAlloc),
+// avec CC74 = profil de frappe et pression de canal = enfoncement de la touche tenue.
+namespace NoteOutput {
+    // S'abonne à KeyEvents (appeler après KeyEvents::init et MidiOut::init)
+    void init();
+    // Abonné KeyEvents: false si la file MIDI est pleine (re-proposé plus tard)
+    bool onKeyEvent(const KeyEvents::KeyEvent& ev);
+    // Nombre de touches tenant actuellement (canal 1..16, note) — diagnostic
+    uint8_t heldCount(uint8_t ch, uint8_t note);
+}
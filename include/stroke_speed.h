@@ -0,0 +1,29 @@
+#pragma once
+#include <stdint.h>
+
+// === Vitesse de frappe 2 / 3 points ===
+// Deux points: delta (départ → déclenchement) sur dt. Trois points: le seuil médian découpe la
+// course en deux segments chronométrés; la vitesse fusionnée pondère le second (fin de course)
+// puis est ré-exprimée en delta sur le dt total, pour passer par la même égalisation et la même
+// courbe que le chemin 2 points. Sans dépendance Arduino: rejoué en natif (test/test_velocity_replay).
+struct StrokeSegments {
+    uint16_t d1;  uint32_t dt1;  // départ → seuil médian
+    uint16_t d2;  uint32_t dt2;  // seuil médian → déclenchement
+};
+
+// Part du second segment dans la vitesse: 0..127, 64 = vitesse constante
+inline uint8_t strokeProfile(const StrokeSegments& g) {
+    const float s1 = (float)g.d1 / (float)g.dt1;
+    const float s2 = (float)g.d2 / (float)g.dt2;
+    return (uint8_t)((127.0f * s2 / (s1 + s2)) + 0.5f);
+}
+
+// Vitesse fusionnée (1 - lateWeight) * s1 + lateWeight * s2, en delta équivalent sur dt
+inline uint16_t threePointDelta(const StrokeSegments& g, uint32_t dt, float lateWeight) {
+    const float s1 = (float)g.d1 / (float)g.dt1;
+    const float s2 = (float)g.d2 / (float)g.dt2;
+    float d = ((1.0f - lateWeight) * s1 + lateWeight * s2) * (float)dt;
+    if (d < 1.f) d = 1.f;
+    if (d > 65535.f) d = 65535.f;
+    return (uint16_t)d;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <Arduino.h>
+
+// === Protocole SysEx de configuration ===
+// Trame: F0 7D 4A <cmd> <données 7 bits...> F7   (7D = fabricant non commercial, 4A = 'J')
+// Valeurs 14 bits sur deux octets (MSB 7 bits, LSB 7 bits); valeurs signées décalées de +64.
+// Les transferts volumineux sont découpés par rangée (un MUX = 16 touches par message):
+// un dump complet = 8 messages, une restauration = 8 SetThresholds.
+//
+//   01 GetInfo                      → 41 proto N_MUX N_CH
+//   02 GetThresholds mux|7F         → 42 mux {low14 high14}x16   (7F = dump des 8 rangées)
+//   03 SetThresholds mux {low14 high14}x16
+//   04 GetCurve c                   → 44 c n {x14 y}xn
+//   05 SetCurve c n {x14 y}xn       (courbes éditables 1..3)
+//   06 GetKeyCurves mux|7F          → 46 mux {curve}x16
+//   07 SetKeyCurves mux {curve}x16
+//   08 GetLayout                    → 48 kind transpose+64 nz {r0 c0 r1 c1 ch tr+64 curve(7F=garder) lch ltr+64}xnz
+//   09 SetLayout kind nz {zone}xnz
+//   0A GetScan                      → 4A settleUs14 pairDelayCycles14 gamma14(x1000)
+//   0B SetScan settleUs14 pairDelayCycles14 gamma14
+//   0C Save                         (seuils, gamma, courbes, layout → EEPROM)
+// Chaque Set/Save répond 7E <cmd> <status> (0 = ok, 5 = sauvegarde refusée).
+//
+// Réception: le gestionnaire SysEx USB ne fait que recopier les octets dans un tampon borné
+// (analyse incrémentale, message trop long rejeté). service() exécute au plus une commande
+// et prépare au plus un message de réponse par appel; les réponses passent par l'emplacement
+// SysEx basse priorité de MidiOut, jamais devant une note.
+namespace SysexConfig {
+    constexpr uint8_t kManufacturer = 0x7D;
+    constexpr uint8_t kDeviceId     = 0x4A;
+    constexpr uint8_t kProtocol     = 1;
+
+    enum class Status : uint8_t { Ok = 0, BadLength = 1, BadValue = 2, Busy = 3, Unknown = 4, Error = 5 };
+
+    // Enregistre le gestionnaire SysEx USB
+    void init();
+    // Lecture USB bornée + une commande + un message de réponse au plus
+    void service();
+    // Alimente le parseur (gestionnaire USB ou build hôte); data peut être un fragment
+    void feed(const uint8_t* data, uint16_t len);
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// === Compensation en température ===
+// Les offsets des capteurs hall et la référence ADC dérivent avec la température: entre un
+// démarrage à froid et une scène chaude, les points de croisement thLow/thHigh se déplacent.
+// On lit la température de la puce (tempmon, filtrée), on apprend par touche deux pentes par
+// moindres carrés: repos(T) (via BaselineTracker) et course |High - repos|(T) (échantillonnée
+// quand High a bougé, donc après jeu). Dès qu'une touche a vu assez d'écart de température,
+// ses seuils sont décalés par petits pas (touche IDLE uniquement, hors calibration). Avec
+// kBaselineTracking, Low appartient au BaselineTracker (repos mesuré): seul High est décalé
+// (repos prédit + course), sinon les deux contrôleurs se disputeraient Low.
+// DEBUG_TEMP_LOG imprime un CSV (temps, température, repos/Low/High par touche) pour ajuster
+// le modèle hors ligne.
+namespace TempComp {
+    void init();
+    void service(uint32_t nowMs);
+
+    // Température filtrée (°C) et pentes apprises (counts/°C, 0 si modèle non valide)
+    float temperatureC();
+    float restSlope(uint8_t mux, uint8_t ch);
+    float swingSlope(uint8_t mux, uint8_t ch);
+}
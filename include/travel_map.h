@@ -0,0 +1,39 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// === Linéarisation capteur hall → course physique ===
+// Le champ de l'aimant varie en ~1/d^n: un même delta ADC près de thLow et près de thHigh
+// ne correspond pas à la même distance. Chaque touche reçoit une table ADC → course
+// (17 noeuds uint8 entre le repos et le fond de course), construite pendant la Phase2
+// de calibration à partir de la médiane de repos et du pic mesurés, avec un modèle
+// dipolaire autour de la sortie à champ nul du capteur. Modèle non ajusté aux mesures:
+// seuls le repos et le pic viennent de la touche (voir kVelocityUseTravel).
+namespace TravelMap {
+    constexpr uint8_t  kSegments      = 16;    // 16 segments → 17 noeuds par touche
+    constexpr uint16_t kKeyTravelUm   = 4000;  // course totale d'un switch MX (~4 mm)
+    constexpr uint16_t kHallQuiescent = 512;   // sortie capteur à champ nul (Vcc/2 en 10 bits)
+    constexpr float    kFieldExponent = 3.0f;  // B ∝ 1/d^n (dipôle)
+    constexpr uint16_t kMinFieldCounts = 8;    // |v - quiescent| minimal pour que le modèle tienne
+
+    // Repos/pic de chaque table (sauvegardés avec les seuils, section Thresholds v2)
+    extern uint16_t gTravelRest[N_MUX][N_CH];
+    extern uint16_t gTravelPeak[N_MUX][N_CH];
+
+    // Construit la table d'une touche depuis le repos (médiane Phase1) et le pic (Phase2)
+    void build(uint8_t m, uint8_t c, uint16_t rest, uint16_t peak);
+    // Reconstruit toutes les tables depuis repos/pic sauvegardés
+    void buildAllFromStored(const uint16_t rest[N_MUX][N_CH], const uint16_t peak[N_MUX][N_CH]);
+    // Repli sans repos/pic sauvegardés (enregistrement antérieur): Low/High avec les marges
+    // CalibCfg inversées, sigma encore inconnu (c'est la marge que donnerait calibNoiseMargin)
+    void buildFromThresholds(uint8_t m, uint8_t c);
+    void buildAllFromThresholds();
+
+    // Low a bougé avec le capteur (dérive, température, SysEx): décale repos/pic et reconstruit
+    void shift(uint8_t m, uint8_t c, int dRest, int dPeak);
+    // Repos mesuré par le suivi de dérive: la table suit, pic décalé d'autant
+    void followRest(uint8_t m, uint8_t c, uint16_t rest);
+
+    // ADC → course en µm (0 au repos, kKeyTravelUm en fond de course), interpolation linéaire
+    uint16_t travelUm(uint8_t m, uint8_t c, uint16_t adc);
+}
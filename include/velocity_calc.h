@@ -1,29 +1,46 @@
 ﻿#pragma once
 #include <Arduino.h>
 #include "config.h"
+#include "velocity_curves.h"
 
-// Runtime velocity gamma (adjustable via encoder)
+// Runtime velocity gamma (adjustable via encoder), compiled into the gamma curve
 extern float gVelocityGamma;
 
+// Speed → position normalized 0..kNormMax (Q16) between minSpeed and maxSpeed. Finer than the
+// curve tables: VelocityCurves interpolates between their entries (a steep gamma keeps its soft end)
+inline uint16_t speedNormQ16(float speed, float minSpeed, float maxSpeed) {
+    float norm = (speed - minSpeed) / (maxSpeed - minSpeed);
+    if (norm < 0.f) norm = 0.f;
+    if (norm > 1.f) norm = 1.f;
+    return static_cast<uint16_t>(norm * (float)VelocityCurves::kNormMax + 0.5f);
+}
+
 // Simple base4-style velocity computation
 // delta_adc: difference between thresholdHigh and starting ADC value (>=1)
 // dt_us: time in microseconds between start and trigger
-// Returns MIDI velocity 1..127
-inline uint8_t computeVelocity(uint16_t delta_adc, uint32_t dt_us) {
-    if (dt_us == 0) return 127; // extreme edge case
+// Returns normalized speed 0..kNormMax, turned into MIDI velocity by the key's curve (VelocityCurves)
+inline uint16_t computeSpeedNorm(uint16_t delta_adc, uint32_t dt_us) {
+    if (dt_us == 0) return VelocityCurves::kNormMax; // extreme edge case
     // Convert to speed (ADC counts per microsecond)
     float speed = static_cast<float>(delta_adc) / static_cast<float>(dt_us);
     // Empirical min/max (same spirit as base4 prototype)
     constexpr float kMinSpeed = 0.001f;  // very slow
     constexpr float kMaxSpeed = 0.05f;   // very fast
-    float norm = (speed - kMinSpeed) / (kMaxSpeed - kMinSpeed);
-    if (norm < 0.f) norm = 0.f;
-    if (norm > 1.f) norm = 1.f;
-    // Courbe: applique un exposant (gamma) pour rendre la réponse plus sensible
-    // aux vitesses lentes quand gamma < 1.0; use runtime gamma
-    norm = powf(norm, gVelocityGamma);
-    uint8_t vel = 1 + static_cast<uint8_t>(norm * 126.0f);
-    if (vel < 1) vel = 1;
-    if (vel > 127) vel = 127;
-    return vel;
+    return speedNormQ16(speed, kMinSpeed, kMaxSpeed);
+}
+
+// Same as computeSpeedNorm but from a linearized travel (TravelMap) in micrometres.
+// Speeds in µm/µs (= m/s): bounds match the ADC ones for a typical ~175-count swing over 4 mm.
+inline uint16_t computeSpeedNormTravel(uint16_t delta_um, uint32_t dt_us) {
+    if (dt_us == 0) return VelocityCurves::kNormMax; // extreme edge case
+    float speed = static_cast<float>(delta_um) / static_cast<float>(dt_us);
+    constexpr float kMinSpeed = 0.02f;   // very slow (2 cm/s)
+    constexpr float kMaxSpeed = 1.0f;    // very fast (1 m/s)
+    return speedNormQ16(speed, kMinSpeed, kMaxSpeed);
+}
+
+// Velocity for a key: normalized speed through the key's compiled curve (branch-free lookup)
+inline uint8_t computeVelocity(uint8_t mux, uint8_t ch, uint16_t delta, uint32_t dt_us) {
+    const uint16_t norm = kVelocityUseTravel ? computeSpeedNormTravel(delta, dt_us) : computeSpeedNorm(delta, dt_us);
+    return VelocityCurves::velocityFor(mux, ch, norm);
 }
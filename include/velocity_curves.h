@@ -0,0 +1,58 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+#include "note_map.h"
+
+// === Moteur de courbes de vélocité ===
+// Plusieurs courbes nommées compilées en tables entières de 257 points (vitesse normalisée
+// 0..256 → vélocité 1..127). La vitesse arrive en Q16 (0..kNormMax): au NoteOn, double index
+// puis interpolation linéaire sur 256 pas entre deux points, sans branchement. Une courbe gamma raide
+// (0.2: point 1 ≈ 42) garde ainsi toutes ses vélocités basses.
+//   0 = gamma  : générée depuis gVelocityGamma (encodeur), comme l'ancienne courbe globale
+//   1..3       : courbes linéaires par morceaux définies par points de contrôle (éditables)
+namespace VelocityCurves {
+    constexpr uint8_t kCurveCount = 4;
+    constexpr uint8_t kGamma = 0, kLinear = 1, kSoft = 2, kHard = 3;
+    constexpr uint8_t kMaxPoints = 8;   // points de contrôle par courbe éditable
+    constexpr uint16_t kLutPoints = 257; // x = 0..256 (256 = fin de course, pour l'interpolation)
+    constexpr uint16_t kNormMax = 65535; // vitesse normalisée Q16: x = norm / 256
+
+    // Points de contrôle: x = vitesse normalisée 0..255 (croissant), y = vélocité 1..127
+    struct CurvePoints {
+        uint8_t n;
+        uint8_t x[kMaxPoints];
+        uint8_t y[kMaxPoints];
+    };
+
+    // Courbes par défaut, chargement EEPROM (points + affectation par touche), compilation des tables.
+    // Appeler après le chargement de gVelocityGamma.
+    void init();
+
+    // Recompile la courbe gamma (après changement de gVelocityGamma)
+    void rebuildGamma();
+
+    // Remplace les points d'une courbe éditable (1..kCurveCount-1) et la recompile
+    bool setCurvePoints(uint8_t curve, const CurvePoints& pts);
+    bool getCurvePoints(uint8_t curve, CurvePoints& out);
+
+    // Affectation des courbes
+    void setKeyCurve(uint8_t mux, uint8_t ch, uint8_t curve);
+    void setAllKeys(uint8_t curve);
+    uint8_t keyCurve(uint8_t mux, uint8_t ch);
+
+    const char* curveName(uint8_t curve);
+
+    // Persistance (section Curves de l'enregistrement de configuration); false si refusée
+    bool save();
+
+    // Recherche NoteOn: table compilée de la courbe de la zone (table publiée) sinon de la touche
+    extern uint8_t gLut[kCurveCount][kLutPoints];
+    extern uint8_t gKeyCurve[N_MUX][N_CH];
+    inline uint8_t velocityFor(uint8_t mux, uint8_t ch, uint16_t normQ16) {
+        const uint8_t zoneCurve = keyOutputs(mux, ch).curve;
+        const uint8_t* lut = gLut[(zoneCurve != kZoneKeepCurve) ? zoneCurve : gKeyCurve[mux][ch]];
+        const uint16_t i = normQ16 >> 8;
+        const int f = normQ16 & 0xFF;
+        return (uint8_t)(lut[i] + ((((int)lut[i + 1] - (int)lut[i]) * f + 128) >> 8));
+    }
+}
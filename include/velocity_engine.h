@@ -13,6 +13,27 @@ public:
     // Process single key measurement - MAIN ENTRY POINT
     static void processKey(uint8_t mux, uint8_t channel, 
                           uint16_t adc_value, uint32_t timestamp_us);
+
+    // Process the 8 samples of one channel (one per MUX) with the quiescent-key prefilter:
+    // IDLE keys resting on the rest side of thLow skip the state machine entirely.
+    static void processChannel(uint8_t channel, const uint16_t values[N_MUX], uint32_t timestamp_us);
+
+    // Rebuild the prefilter band of a key (call after its thresholds changed)
+    static void refreshQuietBand(uint8_t mux, uint8_t channel);
+    static void refreshAllQuietBands();
+
+    // Sensor health: an excluded key never reaches the FSM (its sounding note, if any, is
+    // released first); re-including it restores its normal prefilter band
+    static void setKeyExcluded(uint8_t mux, uint8_t channel, bool excluded, uint32_t timestamp_us);
+
+#if DEBUG_PROFILE_SCAN
+    // Profiling: number of full FSM runs vs prefiltered (skipped) samples since last call
+    static void takeProfileCounters(uint32_t& fsmRuns, uint32_t& quietSkips);
+#endif
+#if DEBUG_VELOCITY_COMPARE
+    // Print the two-point/three-point velocities captured during the scan (call from loop)
+    static void dumpVelocityCompare();
+#endif
     
     // Debug/monitoring functions
     static void printKeyStats(uint8_t mux, uint8_t channel);
@@ -20,8 +41,22 @@ public:
     
 private:
     // Simplified inline state machine in processKey; legacy handlers removed.
-    static void sendNoteOn(uint8_t note, uint8_t velocity, uint8_t mux, uint8_t channel);
-    static void sendNoteOff(uint8_t note, uint8_t mux, uint8_t channel);
+    // Publish key events on the bus (never blocks; outputs are served outside the scan)
+    static void publishPress(uint8_t mux, uint8_t channel, uint8_t velocity, uint32_t timestamp_us);
+    static void publishRelease(uint8_t mux, uint8_t channel, uint32_t timestamp_us);
+    // HELD key depth → rate-limited per-note pressure event (MPE only)
+    static void trackPressure(uint8_t mux, uint8_t channel, KeyData& key, uint16_t adc_value,
+                              uint16_t thHigh, uint32_t timestamp_us);
     static void resetKey(KeyData& key);
+    // Full state machine for one key (bounds already checked, acquisition buffers updated)
+    static void runStateMachine(uint8_t mux, uint8_t channel, KeyData& key,
+                                uint16_t adc_value, uint32_t timestamp_us);
+    // Stroke length from adc_from to adc_to in the active speed units (travel µm or ADC counts)
+    static uint16_t strokeDelta(uint8_t mux, uint8_t channel, uint16_t adc_from, uint16_t adc_to, int s);
+    // NoteOn velocity for the stroke ending at (adc_value, timestamp_us): two-point or fused three-point
+    static uint8_t strokeVelocity(uint8_t mux, uint8_t channel, KeyData& key,
+                                  uint16_t adc_value, uint32_t timestamp_us, int s);
+    static void openQuietBand(uint8_t mux, uint8_t channel);
+    static void closeQuietBand(uint8_t mux, uint8_t channel);
     // Debug helpers removed (no Serial output allowed)
 };
@@ -0,0 +1,35 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// === Égalisation de vitesse par touche ===
+// La course |High-Low| varie beaucoup d'un capteur/aimant à l'autre: à vitesse de doigt égale,
+// la vitesse ADC mesurée diffère. On apprend en jeu normal le 90e percentile de vitesse de
+// chaque touche (estimateur de quantile à pas asymétrique, 3 octets par touche) et on en
+// déduit un gain entier Q8 appliqué au delta (ADC ou course linéarisée) avant la courbe.
+namespace VelocityEq {
+    constexpr uint8_t  kMinNotes   = 16;    // notes avant d'appliquer un gain appris
+    constexpr uint16_t kGainMinQ8  = 128;   // gain mini 0.5x
+    constexpr uint16_t kGainMaxQ8  = 512;   // gain maxi 2.0x
+    constexpr uint32_t kRecomputeMs = 500;  // recalcul des gains au plus toutes les 500 ms
+
+    // Gains neutres puis chargement de l'apprentissage depuis l'EEPROM
+    void init();
+
+    // Appelé au NoteOn: enregistre la frappe (delta ADC ou µm, durée) et renvoie le delta corrigé
+    // par le gain courant de la touche. O(1), une division.
+    uint16_t apply(uint8_t mux, uint8_t ch, uint16_t delta_adc, uint32_t dt_us);
+    // Même correction sans apprentissage (comparaison / rejeu d'une frappe déjà enregistrée)
+    uint16_t scale(uint8_t mux, uint8_t ch, uint16_t delta_adc);
+
+    // Hors scan: recalcule les gains (médiane des p90 comme référence) si de nouvelles notes
+    void service(uint32_t nowMs);
+
+    // Persistance de l'apprentissage (bloc EEPROM auxiliaire)
+    void save();
+    // Oublie tout l'apprentissage (gains neutres)
+    void reset();
+
+    // Gain courant Q8 (256 = 1.0) pour diagnostic
+    uint16_t gainQ8(uint8_t mux, uint8_t ch);
+}
@@ -0,0 +1,175 @@
+#include "baseline_tracker.h"
+#include "calibration.h"
+#include "key_state.h"
+#include "velocity_engine.h"
+#include "velocity_calc.h"
+#include "eeprom_store.h"
+#include "travel_map.h"
+
+namespace {
+struct Drift {
+    int32_t  restQ8;    // EMA of the rest value, Q8
+    uint16_t madQ8;     // EMA of |v - rest| (mean absolute deviation), Q8
+    uint16_t noiseObs;  // accepted samples since anchoring (saturating)
+    uint16_t low;       // Low as last seen/written by the tracker (anchor check)
+    int16_t  margin;    // Low - rest at anchoring (signed: follows polarity)
+    int16_t  drift;     // accumulated Low shift since anchoring
+    uint8_t  idleObs;   // consecutive IDLE observations
+    uint8_t  epoch;     // last step epoch (rate limit)
+    bool     anchored;
+};
+Drift sDrift[N_MUX][N_CH];
+uint16_t sCursor = 0;         // next key to visit (mux * N_CH + ch)
+uint32_t sLastVisitUs = 0;
+uint32_t sLastPersistMs = 0;
+bool sDirty = false;
+uint32_t sRejected = 0;
+
+void reanchor(Drift& d, uint16_t low) {
+    d.low = low;
+    d.anchored = false;
+    d.idleObs = 0;
+    d.drift = 0;
+}
+
+// Gaussian noise: sigma ≈ 1.25 * MAD. Q8 → Q4 with the 5/4 factor folded in.
+uint8_t sigmaQ4(const Drift& d) {
+    const uint32_t q4 = ((uint32_t)d.madQ8 * 5u) >> 6;
+    return (uint8_t)((q4 == 0) ? 1 : (q4 > 255 ? 255 : q4));
+}
+
+void publishSigma(uint8_t m, uint8_t c, const Drift& d) {
+    if (!CalibCfg::kNoiseAdaptive || d.noiseObs < CalibCfg::kNoiseMinObs) return;
+    const uint8_t q4 = sigmaQ4(d);
+    if (q4 == gNoiseSigmaQ4[m][c]) return;
+    gNoiseSigmaQ4[m][c] = q4;
+    calibUpdateRelease(m, c);
+}
+
+void visit(uint8_t m, uint8_t c, uint8_t epoch) {
+    Drift& d = sDrift[m][c];
+    const KeyData& key = g_keys[m][c];
+    const uint16_t low = gThLow[m][c];
+    if (low != d.low) reanchor(d, low); // changed elsewhere: new reference
+    // Firmly IDLE: several consecutive observations at rest
+    if (key.state != KeyState::IDLE) { d.idleObs = 0; return; }
+    if (d.idleObs < kDriftMinIdleObs) { d.idleObs++; return; }
+
+    const int v = (int)key.last_adc;
+    const int s = ((int)gThHigh[m][c] >= (int)low) ? +1 : -1;
+    if (!d.anchored) {
+        // Anchor only on a sample clearly on the rest side of Low
+        if (s * (v - (int)low) > -(int)kDriftMinMarginCounts) return;
+        d.restQ8 = v << 8;
+        d.margin = (int16_t)((int)low - v);
+        d.anchored = true;
+        return;
+    }
+    // Robust EMA: reject samples far from the current estimate (bumps, spikes, half-presses).
+    // The gate widens with the measured noise so a noisy key does not reject its own noise.
+    const int rest = (d.restQ8 + 128) >> 8;
+    const int dev = abs(v - rest);
+    int gate = (int)kDriftOutlierCounts;
+    if (d.noiseObs >= CalibCfg::kNoiseMinObs) {
+        const int g4 = ((int)sigmaQ4(d) * 4) >> 4; // 4 sigma
+        if (g4 > gate) gate = g4;
+    }
+    if (dev > gate) { sRejected++; return; }
+    d.restQ8 += ((v << 8) - d.restQ8) >> kDriftAlphaShift;
+    d.madQ8 = (uint16_t)((int)d.madQ8 + (((dev << 8) - (int)d.madQ8) >> CalibCfg::kNoiseMadShift));
+    if (d.noiseObs < 0xFFFF) d.noiseObs++;
+    publishSigma(m, c, d);
+
+    if (!kBaselineTracking) return;
+    // Bounded change rate: one count per key per epoch, toward rest + margin. The margin is the
+    // one found at anchoring, or k * sigma once the noise of this key is known.
+    if (d.epoch == epoch) return;
+    const int restNow = (d.restQ8 + 128) >> 8;
+    int margin = d.margin;
+    if (CalibCfg::kNoiseAdaptive && gNoiseSigmaQ4[m][c] != 0) {
+        const int s = ((int)gThHigh[m][c] >= (int)low) ? +1 : -1;
+        margin = s * calibNoiseMargin(m, c, CalibCfg::kLowSigmaK, CalibCfg::kLowMarginPct,
+                                      CalibCfg::kLowMarginMinCounts, abs((int)gThHigh[m][c] - restNow));
+    }
+    const int target = restNow + margin;
+    if (target == (int)low) return;
+    int next = (int)low + ((target > (int)low) ? 1 : -1);
+    // Keep the minimum swing to High
+    if (abs((int)gThHigh[m][c] - next) < (int)Calib::kMinSwingCounts) return;
+    if (next < 0 || next > 1023) return;
+    // Single aligned store, then the prefilter band of this key (same thread as the scan)
+    gThLow[m][c] = (uint16_t)next;
+    calibUpdateRelease(m, c);
+    VelocityEngine::refreshQuietBand(m, c);
+    // The sensor moved: the travel map follows the measured rest (peak by the same amount)
+    TravelMap::followRest(m, c, (uint16_t)restNow);
+    d.low = (uint16_t)next;
+    d.drift = (int16_t)(d.drift + (next - (int)low));
+    d.epoch = epoch;
+    sDirty = true;
+}
+} // namespace
+
+namespace BaselineTracker {
+
+void init() {
+    for (uint8_t m = 0; m < N_MUX; m++)
+        for (uint8_t c = 0; c < N_CH; c++) reanchor(sDrift[m][c], gThLow[m][c]);
+    sCursor = 0;
+    sDirty = false;
+    sLastPersistMs = millis();
+}
+
+void service(uint32_t nowUs, uint32_t nowMs) {
+    if ((!kBaselineTracking && !CalibCfg::kNoiseAdaptive) || !calibrationUxIdle()) return;
+    if (nowUs - sLastVisitUs < kDriftVisitUs) return;
+    sLastVisitUs = nowUs;
+    const uint8_t epoch = (uint8_t)(nowMs / kDriftStepMs);
+    for (uint8_t i = 0; i < kDriftKeysPerVisit; i++) {
+        visit((uint8_t)(sCursor / N_CH), (uint8_t)(sCursor % N_CH), epoch);
+        sCursor = (uint16_t)((sCursor + 1) % (N_MUX * N_CH));
+    }
+    // Occasional persistence (background writer; waits for any save already in flight)
+    if (sDirty && nowMs - sLastPersistMs >= kDriftPersistMs && !EepromStore::saveBusy() &&
+        calibrationSaveToEeprom()) {
+        sDirty = false;
+        sLastPersistMs = nowMs;
+    }
+}
+
+void followShift(uint8_t mux, uint8_t ch) {
+    // Keep the anchor (rest EMA and margin are measurements): the shift anticipates a rest
+    // move that the EMA will then observe, so the tracker's target ends up at the same Low.
+    sDrift[mux][ch].low = gThLow[mux][ch];
+}
+
+uint16_t restEstimate(uint8_t mux, uint8_t ch) {
+    const Drift& d = sDrift[mux][ch];
+    return d.anchored ? (uint16_t)((d.restQ8 + 128) >> 8) : 0;
+}
+
+int16_t driftCounts(uint8_t mux, uint8_t ch) { return sDrift[mux][ch].drift; }
+
+uint32_t rejectedSamples() { return sRejected; }
+
+void printNoiseReport() {
+    uint16_t worst = 0, known = 0;
+    uint32_t sum = 0;
+    Serial.println("[NOISE] sigma x100 (counts), '-' = unknown; rows = mux, cols = ch");
+    for (uint8_t m = 0; m < N_MUX; m++) {
+        Serial.printf("[NOISE] m%u", m);
+        for (uint8_t c = 0; c < N_CH; c++) {
+            const uint8_t q4 = gNoiseSigmaQ4[m][c];
+            if (q4 == 0) { Serial.print("    -"); continue; }
+            const uint16_t x100 = (uint16_t)(((uint32_t)q4 * 100u + 8u) >> 4);
+            Serial.printf(" %4u", x100);
+            sum += x100; known++;
+            if (x100 > worst) worst = x100;
+        }
+        Serial.println();
+    }
+    Serial.printf("[NOISE] known=%u avg=%lu max=%u rejected=%lu\n", known,
+                  (unsigned long)(known ? sum / known : 0), worst, (unsigned long)sRejected);
+}
+
+} // namespace BaselineTracker
@@ -2,33 +2,62 @@
 #include "config.h"
 #include "simple_leds.h"
 #include "eeprom_store.h"
-#include "key_state.h" // for g_acquisition
+#include "velocity_engine.h" // prefilter bands follow thresholds
+#include "travel_map.h"
+#include "velocity_calc.h" // gVelocityGamma (saved with the thresholds)
+#include "median_est.h"
 #include <algorithm>
 
 uint16_t gThLow[N_MUX][N_CH];
 uint16_t gThHigh[N_MUX][N_CH];
 uint8_t  gHighFastSeen[N_MUX][N_CH];
+uint16_t gThRelease[N_MUX][N_CH];
+uint8_t  gNoiseSigmaQ4[N_MUX][N_CH];
 
-// === Phase2: histogrammes pour médiane Low ===
-static uint16_t *gHist = nullptr; // allocation unique N_MUX*N_CH*1024 entries (lazy)
-static uint32_t gCountPerKey[N_MUX][N_CH];
+void calibUpdateRelease(uint8_t m, uint8_t c) {
+	const int h = (int)gThHigh[m][c];
+	const int l = (int)gThLow[m][c];
+	const int offset = calibNoiseMargin(m, c, CalibCfg::kReleaseSigmaK, CalibCfg::kReleaseDeltaPct,
+	                                    CalibCfg::kReleaseDeltaMin, abs(h - l));
+	const int s = (h >= l) ? +1 : -1; // signe de la polarité
+	int rel = h - s * offset;
+	if (rel < 0) rel = 0;
+	if (rel > 1023) rel = 1023;
+	gThRelease[m][c] = (uint16_t)rel;
+}
+
+void calibUpdateAllReleases() {
+	for (uint8_t m=0;m<N_MUX;m++) for (uint8_t c=0;c<N_CH;c++) calibUpdateRelease(m, c);
+}
+
+// === Phase2: médiane Low par estimateur en flux (Frugal-2U, median_est.h) ===
+// 4 octets par touche (512 o au total) au lieu d'un histogramme 1024 bins par touche (256 Ko)
+static MedianEst gMedianEst[N_MUX][N_CH];
+// Moyenne glissante Q4 de l'estimation (écart à la médiane exacte ≤ 2 LSB jusqu'à σ = 8,
+// vérifié par test/test_median)
+static uint16_t gMedianSmoothQ4[N_MUX][N_CH];
+static uint16_t gCountPerKey[N_MUX][N_CH]; // saturant: seul « au moins un échantillon » compte
 static uint16_t gMedianFromPhase1[N_MUX][N_CH]; // Store median values calculated in Phase 1
 static bool gKeyPressedInPhase2[N_MUX][N_CH]; // Track which keys were pressed during Phase 2
 enum class CalibState { STATIC_INIT, COLLECT_LOW, FINALIZE_LOW, RUN };
 static CalibState gState = CalibState::STATIC_INIT;
 static uint32_t gCollectStartMs = 0;
+static bool gThresholdsLoaded = false;
 
-static inline uint16_t & histAt(uint8_t m, uint8_t c, uint16_t v) {
-	// Layout: ((m*N_CH)+c)*1024 + v
-	return gHist[ (((size_t)m)*N_CH + c)*1024 + v ];
+static void buildTravelMaps(bool thresholdsLoaded) {
+	uint16_t restTmp[N_MUX][N_CH];
+	uint16_t peakTmp[N_MUX][N_CH];
+	if (thresholdsLoaded && EepromStore::loadTravel(restTmp, peakTmp)) TravelMap::buildAllFromStored(restTmp, peakTmp);
+	else TravelMap::buildAllFromThresholds();
 }
 
 void calibrationInitStatic() {
 	gState = CalibState::STATIC_INIT;
-	// Try load from EEPROM first (gamma loaded separately in main.cpp)
+	// Try load from EEPROM first (thresholds + velocity gamma sections of the config record)
 	uint16_t lowTmp[N_MUX][N_CH];
 	uint16_t highTmp[N_MUX][N_CH];
-	bool loaded = EepromStore::load(lowTmp, highTmp, nullptr);
+	bool loaded = EepromStore::load(lowTmp, highTmp, &gVelocityGamma);
+	gThresholdsLoaded = loaded;
 	for (uint8_t m=0;m<N_MUX;m++) {
 		for (uint8_t c=0;c<N_CH;c++) {
 			if (loaded) {
@@ -46,19 +75,16 @@ void calibrationInitStatic() {
 			gCountPerKey[m][c] = 0;
 		}
 	}
+	calibUpdateAllReleases();
+	// Travel linearization: rest/peak measured by the last Phase2 (saved with the thresholds),
+	// else estimated from Low/High until a Phase2 sweep provides them
+	buildTravelMaps(loaded);
 }
 
+bool calibrationLoaded() { return gThresholdsLoaded; }
+
 // Démarre la collecte médiane (appeler depuis setup après init statique)
 void calibrationStartCollectLow() {
-	if (!gHist) {
-		size_t totalEntries = (size_t)N_MUX * (size_t)N_CH * 1024;
-		gHist = (uint16_t*)malloc(totalEntries * sizeof(uint16_t));
-		if (gHist) memset(gHist, 0, totalEntries * sizeof(uint16_t));
-	} else {
-		// reset
-		size_t totalEntries = (size_t)N_MUX * (size_t)N_CH * 1024;
-		memset(gHist, 0, totalEntries * sizeof(uint16_t));
-	}
 	for (uint8_t m=0;m<N_MUX;m++) for (uint8_t c=0;c<N_CH;c++) gCountPerKey[m][c]=0;
 	gCollectStartMs = millis();
 	gState = CalibState::COLLECT_LOW;
@@ -66,14 +92,21 @@ void calibrationStartCollectLow() {
 
 // À appeler chaque frame (après swapBuffers) tant que collecte active
 void calibrationFrameIngest(const uint16_t frameValues[N_MUX][N_CH]) {
-	if (gState != CalibState::COLLECT_LOW || !gHist) return;
-	// Incrémenter histogramme par touche
+	if (gState != CalibState::COLLECT_LOW) return;
+	// Mise à jour de l'estimateur de médiane par touche
 	for (uint8_t m=0;m<N_MUX;m++) {
 		for (uint8_t c=0;c<N_CH;c++) {
 			uint16_t v = frameValues[m][c];
 			if (v > 1023) v = 1023;
-			histAt(m,c,v)++;
-			gCountPerKey[m][c]++;
+			MedianEst& e = gMedianEst[m][c];
+			if (gCountPerKey[m][c] == 0) {
+				medianStart(e, v); // départ sur le premier échantillon
+				gMedianSmoothQ4[m][c] = (uint16_t)(v << 4);
+			} else {
+				medianUpdate(e, v);
+				medianSmooth(gMedianSmoothQ4[m][c], e);
+			}
+			if (gCountPerKey[m][c] < 0xFFFF) gCountPerKey[m][c]++;
 		}
 	}
 	// Vérifier fenêtre temps
@@ -84,31 +117,14 @@ void calibrationFrameIngest(const uint16_t frameValues[N_MUX][N_CH]) {
 }
 
 static void finalizeMedian() {
-	if (!gHist) { gState = CalibState::RUN; return; }
-	
-	// Calculate and store median values from Phase 1 histogram
+	// Store median values from the Phase 1 estimators
 	// DO NOT modify gThLow/gThHigh here - preserve EEPROM values
 	for (uint8_t m=0;m<N_MUX;m++) {
 		for (uint8_t c=0;c<N_CH;c++) {
-			uint32_t total = gCountPerKey[m][c];
-			if (total == 0) {
-				// No data collected: use current Low as fallback median
-				gMedianFromPhase1[m][c] = gThLow[m][c];
-				continue;
-			}
-			uint32_t half = total / 2;
-			uint32_t accum = 0;
-			uint16_t median = 0;
-			for (uint16_t v=0; v<1024; ++v) {
-				accum += histAt(m,c,v);
-				if (accum >= half) { median = v; break; }
-			}
-			gMedianFromPhase1[m][c] = median;
+			// No data collected: use current Low as fallback median
+			gMedianFromPhase1[m][c] = gCountPerKey[m][c] ? medianSmoothed(gMedianSmoothQ4[m][c]) : gThLow[m][c];
 		}
 	}
-	
-	// Free memory and transition to RUN state
-	free(gHist); gHist = nullptr;
 	gState = CalibState::RUN;
 }
 
@@ -130,18 +146,93 @@ void calibrationLoadFromEeprom() {
 			gThLow[m][c] = lowTmp[m][c];
 			gThHigh[m][c] = highTmp[m][c];
 		}
+		calibUpdateAllReleases();
+		buildTravelMaps(true);
+		VelocityEngine::refreshAllQuietBands();
 	}
 }
-void calibrationSaveToEeprom() {
-	// Save thresholds only; gamma is managed separately in main.cpp
-	EepromStore::save(gThLow, gThHigh, nullptr);
+bool calibrationSaveToEeprom() {
+	// Thresholds + travel map ends + current gamma (nullptr would leave the stored gamma)
+	return EepromStore::beginSave(gThLow, gThHigh, TravelMap::gTravelRest, TravelMap::gTravelPeak, &gVelocityGamma);
 }
 
 // === Calibration FSM driven by button 24 (LOW when pressed) ===
-enum class UX { Idle, HoldStart, Phase1, Phase2, HoldEnd };
+enum class UX { Idle, HoldStart, Phase1, Phase2, HoldEnd, Finalize, Saving };
 static UX gUx = UX::Idle;
 static uint32_t gUxT0 = 0;
 static uint16_t gPhase2Peak[N_MUX][N_CH];
+static uint16_t gFinalizeIdx = 0; // next key (mux * N_CH + ch) to finalize
+volatile bool gCalibPeakCapture = false;
+
+// Phase2 per-sample tracking: farthest excursion from Low and pressed-key marking
+void calibrationPeakSample(uint8_t channel, const uint16_t values[N_MUX]) {
+	for (uint8_t m=0;m<N_MUX;m++) {
+		const int low = (int)gThLow[m][channel];
+		const int dv = (int)values[m] - low;
+		const int bestDv = (int)gPhase2Peak[m][channel] - low;
+		if (abs(dv) > abs(bestDv)) {
+			gPhase2Peak[m][channel] = values[m];
+		}
+		// Mark key as pressed if swing exceeds minimum threshold
+		if (abs(dv) >= (int)Calib::kMinSwingCounts) {
+			gKeyPressedInPhase2[m][channel] = true;
+		}
+	}
+}
+
+// Finalize one key: update Low+High ONLY if it was pressed during Phase 2
+static void finalizeKey(uint8_t m, uint8_t c) {
+	// If key was NOT pressed, both gThLow and gThHigh keep their previous EEPROM values
+	if (!gKeyPressedInPhase2[m][c]) return;
+	uint16_t lowPrev = gThLow[m][c];
+	uint16_t peak = gPhase2Peak[m][c];
+
+	// Compute polarity and swing from Phase2 observations
+	int dPeak = (int)peak - (int)lowPrev;
+	int D = abs(dPeak);
+	int s = (dPeak >= 0) ? +1 : -1;
+
+	// Key was pressed: use median from Phase 1 as base
+	uint16_t median = gMedianFromPhase1[m][c];
+	int lowMargin = calibNoiseMargin(m, c, CalibCfg::kLowSigmaK, CalibCfg::kLowMarginPct,
+	                                 CalibCfg::kLowMarginMinCounts, D);
+	int lowNew = (int)median + s * lowMargin;
+	if (lowNew < 0) lowNew = 0;
+	if (lowNew > 1023) lowNew = 1023;
+	gThLow[m][c] = (uint16_t)lowNew;
+
+	uint16_t lowFinal = gThLow[m][c]; // Use updated Low
+	int dFinal = (int)peak - (int)lowFinal;
+	int DFinal = abs(dFinal);
+	int sFinal = (dFinal >= 0) ? +1 : -1;
+
+	if (DFinal < (int)Calib::kMinSwingForHigh) {
+		// Too small swing: enforce minimum around Low in the press direction
+		int target = (int)lowFinal + sFinal * (int)Calib::kMinSwingCounts;
+		if (target < 0) target = 0;
+		if (target > 1023) target = 1023;
+		gThHigh[m][c] = (uint16_t)target;
+	} else {
+		int margin = calibNoiseMargin(m, c, CalibCfg::kHighSigmaK, CalibCfg::kHighTargetMarginPct,
+		                              CalibCfg::kHighTargetMarginMin, DFinal);
+		int target = (int)peak - sFinal * margin;
+		// Enforce minimal swing symmetrical to polarity
+		int minTarget = (int)lowFinal + sFinal * (int)Calib::kMinSwingCounts;
+		if (sFinal > 0) {
+			if (target < minTarget) target = minTarget;
+		} else {
+			if (target > minTarget) target = minTarget;
+		}
+		if (target < 0) target = 0;
+		if (target > 1023) target = 1023;
+		gThHigh[m][c] = (uint16_t)target;
+	}
+	// ADC→travel table from the measured rest (median) and bottom (peak)
+	TravelMap::build(m, c, gMedianFromPhase1[m][c], peak);
+	calibUpdateRelease(m, c);
+	// New thresholds: rebuild this key's prefilter band before it is scanned again
+	VelocityEngine::refreshQuietBand(m, c);
+}
 
 void calibrationServiceFSM(uint32_t nowMs, bool button24Low) {
 	switch (gUx) {
@@ -179,112 +270,61 @@ void calibrationServiceFSM(uint32_t nowMs, bool button24Low) {
 					// Enable solid blue override on all LEDs during Phase 2
 					setCalibrationLeds(false);
 					simpleLedsSetCalibrationBlue(true);
+					gCalibPeakCapture = true; // peaks now tracked per sample in the scan
 					gUx = UX::Phase2; gUxT0 = nowMs;
 				}
 			}
 			break; }
-		case UX::Phase2: {
-			// During Phase2, update peaks from current workingValues and mark pressed keys
-			for (uint8_t m=0;m<N_MUX;m++) {
-				for (uint8_t c=0;c<N_CH;c++) {
-					uint16_t low = gThLow[m][c];
-					uint16_t v = g_acquisition.workingValues[m][c];
-					int dv = (int)v - (int)low;
-					int bestDv = (int)gPhase2Peak[m][c] - (int)low;
-					if (abs(dv) > abs(bestDv)) {
-						gPhase2Peak[m][c] = v;
-					}
-					// Mark key as pressed if swing exceeds minimum threshold
-					if (abs(dv) >= (int)Calib::kMinSwingCounts) {
-						gKeyPressedInPhase2[m][c] = true;
-					}
-				}
-			}
+		case UX::Phase2:
+			// Peaks and pressed keys are tracked per sample (calibrationPeakSample)
 			if (button24Low) {
 				gUx = UX::HoldEnd; gUxT0 = nowMs;
 			}
-			break; }
+			break;
 		case UX::HoldEnd:
 			if (!button24Low) { gUx = UX::Phase2; break; }
 			if (nowMs - gUxT0 >= Calib::kHoldToFinishMs) {
-				// Finalize: update Low+High ONLY for pressed keys
-				for (uint8_t m=0;m<N_MUX;m++) {
-					for (uint8_t c=0;c<N_CH;c++) {
-						uint16_t lowPrev = gThLow[m][c];
-						uint16_t peak = gPhase2Peak[m][c];
-						
-						// Compute polarity and swing from Phase2 observations
-						int dPeak = (int)peak - (int)lowPrev;
-						int D = abs(dPeak);
-						int s = (dPeak >= 0) ? +1 : -1;
-						
-						// Update Low ONLY if key was pressed (significant swing detected)
-						if (gKeyPressedInPhase2[m][c]) {
-							// Key was pressed: use median from Phase 1 as base
-							uint16_t median = gMedianFromPhase1[m][c];
-							int lowMargin = std::max<int>((int)CalibCfg::kLowMarginMinCounts, 
-							                               (int)(CalibCfg::kLowMarginPct * (float)D));
-							int lowNew = (int)median + s * lowMargin;
-							if (lowNew < 0) lowNew = 0; 
-							if (lowNew > 1023) lowNew = 1023;
-							gThLow[m][c] = (uint16_t)lowNew;
-						}
-						// If key was NOT pressed: keep existing Low from EEPROM/previous calibration
-
-						// Update High ONLY if key was pressed during Phase 2
-						if (gKeyPressedInPhase2[m][c]) {
-							uint16_t lowFinal = gThLow[m][c]; // Use potentially updated Low
-							int dFinal = (int)peak - (int)lowFinal;
-							int DFinal = abs(dFinal);
-							int sFinal = (dFinal >= 0) ? +1 : -1;
-							
-							if (DFinal < (int)Calib::kMinSwingForHigh) {
-								// Too small swing: enforce minimum around Low in the press direction
-								int target = (int)lowFinal + sFinal * (int)Calib::kMinSwingCounts;
-								if (target < 0) target = 0; 
-								if (target > 1023) target = 1023;
-								gThHigh[m][c] = (uint16_t)target;
-							} else {
-								int margin = std::max<int>((int)CalibCfg::kHighTargetMarginMin, 
-								                            (int)(CalibCfg::kHighTargetMarginPct * (float)DFinal));
-								int target = (int)peak - sFinal * margin;
-								// Enforce minimal swing symmetrical to polarity
-								int minTarget = (int)lowFinal + sFinal * (int)Calib::kMinSwingCounts;
-								if (sFinal > 0) {
-									if (target < minTarget) target = minTarget;
-								} else {
-									if (target > minTarget) target = minTarget;
-								}
-								if (target < 0) target = 0; 
-								if (target > 1023) target = 1023;
-								gThHigh[m][c] = (uint16_t)target;
-							}
-						}
-						// If key was NOT pressed, both gThLow and gThHigh keep their previous EEPROM values
-					}
-				}
-				
-				// Count and report how many keys were calibrated
+				// Stop capture before finalizing: the peaks are frozen from here on
+				gCalibPeakCapture = false;
+				// Finalize incrementally (a few keys per loop), then save in the background
+				gFinalizeIdx = 0;
+				gUx = UX::Finalize;
+			}
+			break;
+		case UX::Finalize: {
+			const uint32_t t0 = micros();
+			uint8_t n = 0;
+			while (gFinalizeIdx < N_MUX * N_CH && n < Calib::kFinalizeKeysPerSlice) {
+				finalizeKey((uint8_t)(gFinalizeIdx / N_CH), (uint8_t)(gFinalizeIdx % N_CH));
+				gFinalizeIdx++;
+				n++;
+				if (micros() - t0 >= Calib::kFinalizeBudgetUs) break;
+			}
+			if (gFinalizeIdx < N_MUX * N_CH) break;
+			// Count and report how many keys were calibrated
 #ifdef DEBUG_GAMMA_MONITOR
-				uint16_t calibratedCount = 0;
-				for (uint8_t m=0;m<N_MUX;m++) {
-					for (uint8_t c=0;c<N_CH;c++) {
-						if (gKeyPressedInPhase2[m][c]) calibratedCount++;
-					}
+			uint16_t calibratedCount = 0;
+			for (uint8_t m=0;m<N_MUX;m++) {
+				for (uint8_t c=0;c<N_CH;c++) {
+					if (gKeyPressedInPhase2[m][c]) calibratedCount++;
 				}
-				Serial.printf("[Calibration] Completed: %u keys calibrated (Low+High updated), other keys unchanged\n", calibratedCount);
-#endif
-				
-				// Save to EEPROM and exit calibration
-				calibrationSaveToEeprom();
-				setCalibrationLeds(false);
-				simpleLedsSetCalibrationBlue(false);
-				gUx = UX::Idle;
 			}
+			Serial.printf("[Calibration] Completed: %u keys calibrated (Low+High updated), other keys unchanged\n", calibratedCount);
+#endif
+			// Save to EEPROM (written a few bytes per loop by EepromStore::service)
+			gUx = calibrationSaveToEeprom() ? UX::Saving : UX::Finalize;
+			break; }
+		case UX::Saving:
+			if (EepromStore::saveBusy()) break;
+			setCalibrationLeds(false);
+			simpleLedsSetCalibrationBlue(false);
+			gUx = UX::Idle;
 			break;
 	}
 }
 
+bool calibrationUxIdle() { return gUx == UX::Idle; }
+
 void updateHighAfterNote(uint8_t mux, uint8_t ch, uint16_t peak) {
 	if (mux >= N_MUX || ch >= N_CH) return;
 	uint16_t low = gThLow[mux][ch];
@@ -292,7 +332,8 @@ void updateHighAfterNote(uint8_t mux, uint8_t ch, uint16_t peak) {
 	// Cible High op: peak reculé d'une marge relative
 	// D provisoire: |peak - low| (on se base sur la frappe courante)
 	int D = abs((int)peak - (int)low);
-	int marginRel = (int)std::max<int>((int)CalibCfg::kHighTargetMarginMin, (int)(CalibCfg::kHighTargetMarginPct * (float)D));
+	int marginRel = calibNoiseMargin(mux, ch, CalibCfg::kHighSigmaK, CalibCfg::kHighTargetMarginPct,
+	                                 CalibCfg::kHighTargetMarginMin, D);
 	int s = ((int)peak >= (int)low) ? +1 : -1;
 	int target = (int)peak - s * marginRel;
 	if (target < (int)(low + Calib::kMinSwingCounts)) target = low + Calib::kMinSwingCounts;
@@ -304,5 +345,6 @@ void updateHighAfterNote(uint8_t mux, uint8_t ch, uint16_t peak) {
 	if (newH < (int)(low + Calib::kMinSwingCounts)) newH = low + Calib::kMinSwingCounts;
 	if (newH > 1023) newH = 1023;
 	gThHigh[mux][ch] = (uint16_t)newH;
+	calibUpdateRelease(mux, ch);
 	if (gHighFastSeen[mux][ch] < 255) gHighFastSeen[mux][ch]++;
 }
\ No newline at end of file
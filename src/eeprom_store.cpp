@@ -2,6 +2,7 @@
 #include <EEPROM.h>
 
 namespace {
+    // Legacy v2 thresholds block (read-only migration source, offset 0)
     struct Header {
         uint32_t magic;   // 'J2TH'
         uint16_t version; // 2 (added velocity gamma)
@@ -13,12 +14,76 @@ namespace {
     constexpr uint32_t kMagic = 0x4A325448; // 'J2TH'
     constexpr uint16_t kVersion = 2;
 
-    uint32_t crc32_update(uint32_t crc, uint8_t data) {
-        crc ^= data;
-        for (uint8_t i = 0; i < 8; i++) {
-            crc = (crc >> 1) ^ (0xEDB88320UL & (-(int)(crc & 1)));
+    // A/B slot header shared by the config record and the remaining binary block(s):
+    // the valid slot with the newest generation wins.
+    struct BlockHeader {
+        uint32_t magic;   // 'J2CF' (config record) or 'J2BK' (block)
+        uint8_t  id;      // config: format version; block: legacy block id
+        uint8_t  gen;     // generation (wrapping)
+        uint16_t len;     // payload length
+        uint32_t crc;     // CRC32 of payload
+    } __attribute__((packed));
+
+    constexpr uint32_t kBlockMagic = 0x4A32424B;  // 'J2BK'
+    constexpr uint32_t kConfigMagic = 0x4A324346; // 'J2CF'
+    constexpr uint8_t  kConfigVersion = 3;        // v3 = TLV sections (v2 = fixed thresholds layout)
+
+    // Config payload: a list of sections { tag, version, len, data[len] }. Unknown tags are
+    // skipped, missing ones keep their defaults, so a new section never invalidates the others.
+    struct SectionHeader {
+        uint8_t  tag;     // EepromStore::Section
+        uint8_t  version; // layout version of this section
+        uint16_t len;
+    } __attribute__((packed));
+
+    // Thresholds v1 (legacy, still read): low[] then high[] as uint16.
+    // v2: per key low, high, travel rest, travel peak on 10 bits each, packed in 5 bytes.
+    constexpr size_t kThresholdsSize = (size_t)N_MUX * N_CH * sizeof(uint16_t) * 2; // v1: low + high
+    constexpr size_t kThresholdsV2Size = (size_t)N_MUX * N_CH * 5;
+    constexpr uint8_t kThresholdsVersion = 2;
+    constexpr uint16_t kConfigMaxLen = 880;
+
+    enum SlotIdx : uint8_t {
+        kSlotSpeedEq = 0,   // live block (EepromStore::Block::SpeedEq)
+        kSlotConfig,        // live TLV config record
+        kSlotOldCurves,     // migration sources (written by earlier firmware)
+        kSlotOldLayout,
+        kSlotOldThresholds,
+        kSlotCount
+    };
+    struct BlockSlot {
+        uint16_t offset[2]; // EEPROM offsets of the A and B headers
+        uint16_t maxLen;    // payload capacity
+        uint32_t magic;
+        uint8_t  id;
+    };
+    // Config A covers the legacy thresholds area; config B uses the free tail. Its first commit
+    // goes to B so the legacy data stays readable until the migrated record is valid.
+    constexpr BlockSlot kSlots[kSlotCount] = {
+        {{1024, 2608}, 512, kBlockMagic, 0},               // SpeedEq: 128 x (p90 uint16 + count uint8)
+        {{0,    3380}, kConfigMaxLen, kConfigMagic, kConfigVersion},
+        {{1548, 3132}, 160, kBlockMagic, 1},               // old Curves block
+        {{1720, 3304}, 64,  kBlockMagic, 2},               // old Layout block
+        {{0,    2048}, (uint16_t)(kThresholdsSize + sizeof(float)), kBlockMagic, 3}, // old A/B thresholds
+    };
+    static_assert(sizeof(BlockHeader) + kConfigMaxLen <= 1024, "config slot A overlaps SpeedEq A");
+    static_assert(3380 + sizeof(BlockHeader) + kConfigMaxLen <= 4284, "config slot B exceeds EEPROM");
+
+    // CRC32 (IEEE, reflected) with a 256-entry table built at compile time (lives in flash)
+    struct CrcTable {
+        uint32_t t[256];
+        constexpr CrcTable() : t() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) c = (c >> 1) ^ (0xEDB88320UL & (0u - (c & 1u)));
+                t[i] = c;
+            }
         }
-        return crc;
+    };
+    constexpr CrcTable kCrc;
+
+    inline uint32_t crc32_update(uint32_t crc, uint8_t data) {
+        return (crc >> 8) ^ kCrc.t[(crc ^ data) & 0xFF];
     }
 
     uint32_t crc32_buf(const uint8_t* buf, size_t len) {
@@ -26,90 +91,407 @@ namespace {
         for (size_t i = 0; i < len; ++i) crc = crc32_update(crc, buf[i]);
         return ~crc;
     }
+
+    // Active slot per live record: 0 = A, 1 = B, 0xFF = none
+    uint8_t sActive[kSlotConfig + 1] = {0xFF, 0xFF};
+    uint8_t sGen[kSlotConfig + 1];
+    bool sStarted = false;
+
+    // RAM images (header + payload): the config image is also the parsed config, read once
+    uint8_t sSpeedEqImage[sizeof(BlockHeader) + 512];
+    uint8_t sConfigImage[sizeof(BlockHeader) + kConfigMaxLen];
+    uint16_t sConfigLen = 0;   // used payload bytes in sConfigImage
+
+    uint8_t* image(uint8_t slot) { return (slot == kSlotConfig) ? sConfigImage : sSpeedEqImage; }
+
+    // What each A/B slot holds, as far as known (header + payload prefix): the commit engine diffs
+    // against RAM instead of EEPROM.read, a sector-log scan on Teensy 4. Known after a commit to
+    // that slot, or for the config slot read at boot; unknown bytes fall back to EEPROM.read.
+    uint8_t sSpeedEqShadow[2][sizeof(sSpeedEqImage)];
+    uint8_t sConfigShadow[2][sizeof(sConfigImage)];
+    uint16_t sShadowLen[kSlotConfig + 1][2];
+
+    uint8_t* shadow(uint8_t slot, uint8_t ab) { return (slot == kSlotConfig) ? sConfigShadow[ab] : sSpeedEqShadow[ab]; }
+
+    // Commit engine: snapshot images written to the inactive slot
+    struct Job {
+        bool     pending;  // snapshot waiting to be (re)started
+        bool     running;
+        uint8_t  target;   // slot being written
+        uint16_t cursor;   // next image byte to compare/write
+        uint16_t size;     // header + payload
+    };
+    Job sJobs[kSlotConfig + 1];
+    uint8_t sJobNext = 0;
+    EepromStore::Stats sStats{};
+    uint16_t sJobWritten = 0;
+
+    bool readHeader(uint8_t slot, uint8_t ab, BlockHeader& hdr) {
+        EEPROM.get(kSlots[slot].offset[ab], hdr);
+        return hdr.magic == kSlots[slot].magic && hdr.id == kSlots[slot].id && hdr.len <= kSlots[slot].maxLen;
+    }
+
+    // Payload straight into dst with the CRC computed on the fly
+    bool readPayload(uint8_t slot, uint8_t ab, const BlockHeader& hdr, uint8_t* dst) {
+        const uint16_t base = kSlots[slot].offset[ab] + sizeof(BlockHeader);
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 0; i < hdr.len; ++i) {
+            dst[i] = EEPROM.read(base + i);
+            crc = crc32_update(crc, dst[i]);
+        }
+        return ~crc == hdr.crc;
+    }
+
+    // Newest valid copy of a slot pair into dst (at most cap bytes; newer header first, older
+    // as fallback). Returns 0/1 for the slot used, 0xFF if none; hdrOut receives its header.
+    uint8_t readNewest(uint8_t slot, uint8_t* dst, size_t cap, BlockHeader& hdrOut) {
+        BlockHeader h[2];
+        const bool ok0 = readHeader(slot, 0, h[0]);
+        const bool ok1 = readHeader(slot, 1, h[1]);
+        uint8_t first = (ok0 && ok1) ? (((int8_t)(uint8_t)(h[1].gen - h[0].gen) > 0) ? 1 : 0) : (ok1 ? 1 : 0);
+        for (uint8_t k = 0; k < 2; k++) {
+            const uint8_t ab = (uint8_t)(first ^ k);
+            if (!(ab ? ok1 : ok0) || h[ab].len > cap) continue;
+            if (readPayload(slot, ab, h[ab], dst)) { hdrOut = h[ab]; return ab; }
+        }
+        return 0xFF;
+    }
+
+    // --- TLV helpers on the RAM config image ---
+    uint8_t* configPayload() { return sConfigImage + sizeof(BlockHeader); }
+
+    // Locate a section; returns its data pointer (nullptr if absent)
+    uint8_t* findSection(uint8_t tag, uint16_t* lenOut, uint16_t* entryOff = nullptr, uint8_t* versionOut = nullptr) {
+        uint8_t* p = configPayload();
+        uint16_t off = 0;
+        while (off + sizeof(SectionHeader) <= sConfigLen) {
+            SectionHeader sh;
+            memcpy(&sh, p + off, sizeof(sh));
+            if (off + sizeof(SectionHeader) + sh.len > sConfigLen) break; // truncated entry
+            if (sh.tag == tag) {
+                if (lenOut) *lenOut = sh.len;
+                if (entryOff) *entryOff = off;
+                if (versionOut) *versionOut = sh.version;
+                return p + off + sizeof(SectionHeader);
+            }
+            off = (uint16_t)(off + sizeof(SectionHeader) + sh.len);
+        }
+        return nullptr;
+    }
+
+    // Replace (or append) a section in the image; false if it does not fit
+    bool putSection(uint8_t tag, uint8_t version, const void* data, uint16_t len) {
+        uint16_t oldLen = 0, entryOff = 0;
+        uint8_t* cur = findSection(tag, &oldLen, &entryOff);
+        uint8_t* p = configPayload();
+        if (cur && oldLen == len) {
+            p[entryOff + 1] = version;
+            memcpy(cur, data, len);
+            return true;
+        }
+        const uint16_t without = cur ? (uint16_t)(sConfigLen - sizeof(SectionHeader) - oldLen) : sConfigLen;
+        if ((size_t)without + sizeof(SectionHeader) + len > kConfigMaxLen) return false;
+        if (cur) {
+            // Drop the old entry (sections keep their relative order otherwise)
+            const uint16_t next = (uint16_t)(entryOff + sizeof(SectionHeader) + oldLen);
+            memmove(p + entryOff, p + next, sConfigLen - next);
+            sConfigLen = without;
+        }
+        const SectionHeader sh{tag, version, len};
+        memcpy(p + sConfigLen, &sh, sizeof(sh));
+        memcpy(p + sConfigLen + sizeof(sh), data, len);
+        sConfigLen = (uint16_t)(sConfigLen + sizeof(sh) + len);
+        return true;
+    }
+
+    // Complete the header of an image and queue it (gen is set when the job starts)
+    void queueImage(uint8_t slot, uint16_t len) {
+        uint8_t* img = image(slot);
+        BlockHeader hdr{};
+        hdr.magic = kSlots[slot].magic;
+        hdr.id = kSlots[slot].id;
+        hdr.len = len;
+        hdr.crc = crc32_buf(img + sizeof(BlockHeader), len);
+        memcpy(img, &hdr, sizeof(BlockHeader));
+        Job& j = sJobs[slot];
+        if (j.running) sStats.restarts++;
+        j.pending = true;
+        j.running = false;
+        j.size = (uint16_t)(sizeof(BlockHeader) + len);
+    }
+
+    void startJob(uint8_t slot) {
+        Job& j = sJobs[slot];
+        // Write into the slot that does not hold the newest valid copy; with none yet, B first
+        // (A may still hold data from earlier firmware until B commits).
+        j.target = (sActive[slot] == 1) ? 0 : 1;
+        const uint8_t gen = (sActive[slot] == 0xFF) ? 1 : (uint8_t)(sGen[slot] + 1);
+        image(slot)[offsetof(BlockHeader, gen)] = gen;
+        j.cursor = 0;
+        j.pending = false;
+        j.running = true;
+        sJobWritten = 0;
+    }
+
+    // Thresholds v2 entry of one key: 4 x 10 bits, little-endian
+    void packKey(uint8_t* dst, uint16_t low, uint16_t high, uint16_t rest, uint16_t peak) {
+        const uint64_t v = (uint64_t)(low & 0x3FF) | ((uint64_t)(high & 0x3FF) << 10) |
+                           ((uint64_t)(rest & 0x3FF) << 20) | ((uint64_t)(peak & 0x3FF) << 30);
+        for (uint8_t i = 0; i < 5; i++) dst[i] = (uint8_t)(v >> (8 * i));
+    }
+    uint16_t unpackField(const uint8_t* src, uint8_t field) {
+        uint64_t v = 0;
+        for (uint8_t i = 0; i < 5; i++) v |= (uint64_t)src[i] << (8 * i);
+        return (uint16_t)((v >> (10 * field)) & 0x3FF);
+    }
+
+    // Thresholds section and its version, if its length matches that version
+    const uint8_t* findThresholds(uint8_t& version) {
+        uint16_t n = 0;
+        const uint8_t* buf = findSection((uint8_t)EepromStore::Section::Thresholds, &n, nullptr, &version);
+        if (!buf) return nullptr;
+        if ((version == 1 && n == kThresholdsSize) || (version == 2 && n == kThresholdsV2Size)) return buf;
+        return nullptr; // unknown (newer) layout: keep the defaults
+    }
+
+    // No TLV record yet: build one from the v2 / A-B block layouts and queue it once
+    void migrate() {
+        bool any = false;
+        uint8_t* p = configPayload();
+        BlockHeader hdr{};
+        // Thresholds + gamma: A/B thresholds block, else the v2 block. Read straight into the
+        // image where the sections will live, then framed in place.
+        uint8_t* th = p + sizeof(SectionHeader);
+        bool haveTh = readNewest(kSlotOldThresholds, th, kThresholdsSize + sizeof(float), hdr) != 0xFF &&
+                      hdr.len == kThresholdsSize + sizeof(float);
+        if (!haveTh) {
+            Header v2{};
+            EEPROM.get(0, v2);
+            if (v2.magic == kMagic && v2.version == kVersion && v2.nMux == N_MUX && v2.nCh == N_CH) {
+                uint32_t crc = 0xFFFFFFFFu;
+                for (size_t i = 0; i < kThresholdsSize + sizeof(float); ++i) {
+                    th[i] = EEPROM.read(sizeof(Header) + i);
+                    crc = crc32_update(crc, th[i]);
+                }
+                haveTh = (~crc == v2.crc);
+            }
+        }
+        if (haveTh) {
+            float gamma;
+            memcpy(&gamma, th + kThresholdsSize, sizeof(float));
+            const SectionHeader sh{(uint8_t)EepromStore::Section::Thresholds, 1, (uint16_t)kThresholdsSize};
+            memcpy(p, &sh, sizeof(sh));
+            sConfigLen = (uint16_t)(sizeof(sh) + kThresholdsSize);
+            putSection((uint8_t)EepromStore::Section::Gamma, 1, &gamma, sizeof(gamma));
+            any = true;
+        }
+        // Curves / layout blocks: payload read after the current end, then framed in place
+        const uint8_t olds[2] = {kSlotOldCurves, kSlotOldLayout};
+        const EepromStore::Section tags[2] = {EepromStore::Section::Curves, EepromStore::Section::Layout};
+        for (uint8_t k = 0; k < 2; k++) {
+            uint8_t* dst = p + sConfigLen + sizeof(SectionHeader);
+            if (sConfigLen + sizeof(SectionHeader) + kSlots[olds[k]].maxLen > kConfigMaxLen) continue;
+            if (readNewest(olds[k], dst, kSlots[olds[k]].maxLen, hdr) == 0xFF) continue;
+            const SectionHeader sh{(uint8_t)tags[k], 1, hdr.len};
+            memcpy(p + sConfigLen, &sh, sizeof(sh));
+            sConfigLen = (uint16_t)(sConfigLen + sizeof(sh) + hdr.len);
+            any = true;
+        }
+        if (any) queueImage(kSlotConfig, sConfigLen);
+    }
 }
 
 namespace EepromStore {
-    static size_t payloadSize() {
-        return (size_t)N_MUX * (size_t)N_CH * sizeof(uint16_t) * 2 + sizeof(float); // low + high + gamma
+    void begin() {
+        if (sStarted) return;
+        sStarted = true;
+        BlockHeader hdr{};
+        // Config record: read and verified once, straight into the RAM image
+        sActive[kSlotConfig] = readNewest(kSlotConfig, configPayload(), kConfigMaxLen, hdr);
+        if (sActive[kSlotConfig] != 0xFF) {
+            sGen[kSlotConfig] = hdr.gen;
+            sConfigLen = hdr.len;
+            uint8_t* sh = shadow(kSlotConfig, sActive[kSlotConfig]);
+            memcpy(sh, &hdr, sizeof(BlockHeader));
+            memcpy(sh + sizeof(BlockHeader), configPayload(), hdr.len);
+            sShadowLen[kSlotConfig][sActive[kSlotConfig]] = (uint16_t)(sizeof(BlockHeader) + hdr.len);
+        } else {
+            sConfigLen = 0;
+            migrate();
+        }
+        // SpeedEq: only the active slot is located here, its payload is read by loadBlock
+        BlockHeader a{}, b{};
+        const bool va = readHeader(kSlotSpeedEq, 0, a), vb = readHeader(kSlotSpeedEq, 1, b);
+        if (va && vb) sActive[kSlotSpeedEq] = ((int8_t)(uint8_t)(b.gen - a.gen) > 0) ? 1 : 0;
+        else sActive[kSlotSpeedEq] = va ? 0 : (vb ? 1 : 0xFF);
+        sGen[kSlotSpeedEq] = (sActive[kSlotSpeedEq] == 1) ? b.gen : a.gen;
+    }
+
+    uint8_t sectionVersion(Section tag) {
+        begin();
+        uint8_t version = 0;
+        return findSection((uint8_t)tag, nullptr, nullptr, &version) ? version : 0;
+    }
+
+    size_t loadSection(Section tag, void* data, size_t len, uint8_t version) {
+        begin();
+        uint16_t n = 0;
+        uint8_t stored = 0;
+        const uint8_t* src = findSection((uint8_t)tag, &n, nullptr, &stored);
+        // Another layout (newer firmware, or older one the caller migrates itself): not copied
+        if (!src || stored != version) return 0;
+        const size_t copy = (n < len) ? n : len;
+        memcpy(data, src, copy);
+        return copy;
+    }
+
+    bool saveSection(Section tag, const void* data, size_t len, uint8_t version) {
+        begin();
+        if (len > kConfigMaxLen || !putSection((uint8_t)tag, version, data, (uint16_t)len)) return false;
+        queueImage(kSlotConfig, sConfigLen);
+        return true;
     }
 
     bool load(uint16_t low[N_MUX][N_CH], uint16_t high[N_MUX][N_CH], float* gamma) {
-        Header hdr{};
-        EEPROM.get(0, hdr);
-        if (hdr.magic != kMagic || hdr.version != kVersion || hdr.nMux != N_MUX || hdr.nCh != N_CH) {
-            return false;
-        }
-        size_t off = sizeof(Header);
-        size_t psize = payloadSize();
-        // Read into a temp buffer to verify CRC
-        uint8_t* buf = (uint8_t*)malloc(psize);
+        begin();
+        uint8_t version = 0;
+        const uint8_t* buf = findThresholds(version);
         if (!buf) return false;
-        for (size_t i = 0; i < psize; ++i) {
-            buf[i] = EEPROM.read(off + i);
-        }
-        uint32_t crc = crc32_buf(buf, psize);
-        if (crc != hdr.crc) {
-            free(buf);
-            return false;
-        }
-        // Unpack
         size_t idx = 0;
         for (uint8_t m = 0; m < N_MUX; ++m) {
             for (uint8_t c = 0; c < N_CH; ++c) {
-                uint16_t v = (uint16_t)buf[idx] | ((uint16_t)buf[idx+1] << 8);
-                low[m][c] = v; idx += 2;
+                if (version == 2) {
+                    const uint8_t* k = buf + ((size_t)m * N_CH + c) * 5;
+                    low[m][c] = unpackField(k, 0);
+                    high[m][c] = unpackField(k, 1);
+                } else {
+                    low[m][c] = (uint16_t)buf[idx] | ((uint16_t)buf[idx+1] << 8);
+                    high[m][c] = (uint16_t)buf[kThresholdsSize / 2 + idx] | ((uint16_t)buf[kThresholdsSize / 2 + idx + 1] << 8);
+                    idx += 2;
+                }
             }
         }
+        if (gamma) loadSection(Section::Gamma, gamma, sizeof(float));
+        return true;
+    }
+
+    bool loadTravel(uint16_t rest[N_MUX][N_CH], uint16_t peak[N_MUX][N_CH]) {
+        begin();
+        uint8_t version = 0;
+        const uint8_t* buf = findThresholds(version);
+        if (!buf || version < 2) return false; // v1 records predate the stored travel ends
         for (uint8_t m = 0; m < N_MUX; ++m) {
             for (uint8_t c = 0; c < N_CH; ++c) {
-                uint16_t v = (uint16_t)buf[idx] | ((uint16_t)buf[idx+1] << 8);
-                high[m][c] = v; idx += 2;
+                const uint8_t* k = buf + ((size_t)m * N_CH + c) * 5;
+                rest[m][c] = unpackField(k, 2);
+                peak[m][c] = unpackField(k, 3);
             }
         }
-        // Load gamma if pointer provided
-        if (gamma) {
-            memcpy(gamma, &buf[idx], sizeof(float));
-        }
-        free(buf);
         return true;
     }
 
-    void save(const uint16_t low[N_MUX][N_CH], const uint16_t high[N_MUX][N_CH], const float* gamma) {
-        Header hdr{};
-        hdr.magic = kMagic;
-        hdr.version = kVersion;
-        hdr.nMux = N_MUX;
-        hdr.nCh = N_CH;
-        size_t psize = payloadSize();
-        uint8_t* buf = (uint8_t*)malloc(psize);
-        if (!buf) return;
-        size_t idx = 0;
+    bool beginSave(const uint16_t low[N_MUX][N_CH], const uint16_t high[N_MUX][N_CH],
+                   const uint16_t rest[N_MUX][N_CH], const uint16_t peak[N_MUX][N_CH], const float* gamma) {
+        begin();
+        uint8_t buf[kThresholdsV2Size];
         for (uint8_t m = 0; m < N_MUX; ++m) {
             for (uint8_t c = 0; c < N_CH; ++c) {
-                uint16_t v = low[m][c];
-                buf[idx++] = (uint8_t)(v & 0xFF);
-                buf[idx++] = (uint8_t)(v >> 8);
+                packKey(buf + ((size_t)m * N_CH + c) * 5, low[m][c], high[m][c], rest[m][c], peak[m][c]);
             }
         }
-        for (uint8_t m = 0; m < N_MUX; ++m) {
-            for (uint8_t c = 0; c < N_CH; ++c) {
-                uint16_t v = high[m][c];
-                buf[idx++] = (uint8_t)(v & 0xFF);
-                buf[idx++] = (uint8_t)(v >> 8);
+        if (!putSection((uint8_t)Section::Thresholds, kThresholdsVersion, buf, (uint16_t)kThresholdsV2Size)) return false;
+        if (gamma && !putSection((uint8_t)Section::Gamma, 1, gamma, sizeof(float))) return false;
+        queueImage(kSlotConfig, sConfigLen);
+        return true;
+    }
+
+    bool saveBusy() {
+        for (uint8_t s = 0; s <= kSlotConfig; ++s) {
+            if (sJobs[s].pending || sJobs[s].running) return true;
+        }
+        return false;
+    }
+
+    void service(uint16_t maxBytes) {
+        // One record at a time; the header goes last so the old slot stays valid until the end
+        uint8_t slot = sJobNext;
+        if (!sJobs[slot].running) {
+            uint8_t k = 0;
+            while (k <= kSlotConfig && !sJobs[(slot + k) % (kSlotConfig + 1)].pending) k++;
+            if (k > kSlotConfig) return;
+            slot = (uint8_t)((slot + k) % (kSlotConfig + 1));
+            sJobNext = slot;
+            startJob(slot);
+        }
+        const uint32_t t0 = micros();
+        Job& j = sJobs[slot];
+        const uint8_t* img = image(slot);
+        uint8_t* sh = shadow(slot, j.target);
+        const uint16_t known = sShadowLen[slot][j.target];
+        const uint16_t base = kSlots[slot].offset[j.target];
+        uint16_t compares = kEepromComparesPerLoop;
+        // Diff against the target slot: against its RAM shadow where known (free), else one
+        // EEPROM.read per byte (budgeted); unchanged bytes are never written
+        while (maxBytes && j.cursor < j.size) {
+            // Image order: payload (after the header) first, then the header bytes
+            const uint16_t pos = (j.cursor < j.size - sizeof(BlockHeader))
+                                     ? (uint16_t)(sizeof(BlockHeader) + j.cursor)
+                                     : (uint16_t)(j.cursor - (j.size - sizeof(BlockHeader)));
+            uint8_t cur;
+            if (pos < known) {
+                cur = sh[pos];
+            } else {
+                if (!compares) break;
+                compares--;
+                cur = EEPROM.read(base + pos);
+            }
+            if (cur != img[pos]) {
+                EEPROM.write(base + pos, img[pos]);
+                maxBytes--;
+                sStats.bytesWritten++;
+                sJobWritten++;
+            } else {
+                sStats.bytesUnchanged++;
             }
+            sh[pos] = img[pos];
+            j.cursor++;
         }
-        // Save gamma: use provided value or default
-        float gammaVal = gamma ? *gamma : kVelocityGammaDefault;
-        memcpy(&buf[idx], &gammaVal, sizeof(float));
-        hdr.crc = crc32_buf(buf, psize);
-        // Write header
-        EEPROM.put(0, hdr);
-        // Write payload
-        size_t off = sizeof(Header);
-        for (size_t i = 0; i < psize; ++i) {
-            EEPROM.write(off + i, buf[i]);
-        }
-    // Teensy EEPROM writes are applied immediately; no commit required
-        free(buf);
+        const uint32_t dt = micros() - t0;
+        if (dt > sStats.maxServiceUs) sStats.maxServiceUs = dt;
+        if (j.cursor < j.size) return;
+        j.running = false;
+        sActive[slot] = j.target;
+        sGen[slot] = img[offsetof(BlockHeader, gen)];
+        if (j.size > sShadowLen[slot][j.target]) sShadowLen[slot][j.target] = j.size;
+        sStats.commits++;
+        sStats.lastCommitWritten = sJobWritten;
+        sJobNext = (uint8_t)((slot + 1) % (kSlotConfig + 1));
+#if DEBUG_EEPROM_STATS
+        Serial.printf("[EEPROM] %s slot=%c gen=%u written=%u total: commits=%lu written=%lu unchanged=%lu restarts=%lu maxServiceUs=%lu\n",
+                      slot == kSlotConfig ? "config" : "speedEq", j.target ? 'B' : 'A', sGen[slot], sJobWritten,
+                      (unsigned long)sStats.commits, (unsigned long)sStats.bytesWritten,
+                      (unsigned long)sStats.bytesUnchanged, (unsigned long)sStats.restarts,
+                      (unsigned long)sStats.maxServiceUs);
+#endif
+    }
+
+    void getStats(Stats& out) { out = sStats; }
+
+    bool loadBlock(Block id, void* data, size_t len) {
+        if (id != Block::SpeedEq || len > kSlots[kSlotSpeedEq].maxLen) return false;
+        begin();
+        // Newest copy whose CRC checks out; the older one is the fallback
+        BlockHeader hdr{};
+        const uint8_t ab = readNewest(kSlotSpeedEq, (uint8_t*)data, len, hdr);
+        if (ab == 0xFF || hdr.len != len) return false;
+        return true;
+    }
+
+    bool saveBlock(Block id, const void* data, size_t len) {
+        if (id != Block::SpeedEq || len > kSlots[kSlotSpeedEq].maxLen) return false;
+        begin();
+        memcpy(sSpeedEqImage + sizeof(BlockHeader), data, len);
+        queueImage(kSlotSpeedEq, (uint16_t)len);
+        return true;
     }
 }
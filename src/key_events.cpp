@@ -0,0 +1,83 @@
+#include "key_events.h"
+
+namespace {
+// Simple SPSC ring buffer (producer = scan, consumer = service)
+constexpr size_t kQueueSize = 256; // power of two for cheap masking
+// Places réservées aux Release: au plus une Release en attente par touche qui sonne,
+// donc tant que Press/Pressure laissent N_MUX*N_CH places libres, une Release entre toujours.
+constexpr size_t kReleaseReserve = (size_t)N_MUX * N_CH;
+static_assert(kReleaseReserve < kQueueSize - 1, "Ring too small for the Release reserve");
+KeyEvents::KeyEvent qbuf[kQueueSize];
+volatile uint16_t qHead = 0; // write index
+volatile uint16_t qTail = 0; // read index
+uint32_t sDropped = 0;
+
+// Touches dont le Press est entré dans l'anneau (côté producteur uniquement). Seules celles-ci
+// publient leur Release: un Press refusé ne laisse pas une Release orpheline entamer la réserve.
+uint32_t sPressAccepted[(kReleaseReserve + 31) / 32];
+inline uint32_t pressBit(uint8_t key) { return 1u << (key & 31); }
+
+KeyEvents::Subscriber sSubs[KeyEvents::kMaxSubscribers];
+uint8_t sSubCount = 0;
+uint8_t sDeliveredMask = 0; // abonnés ayant déjà accepté l'événement en tête
+
+inline uint16_t nextIndex(uint16_t idx) { return static_cast<uint16_t>((idx + 1) & (kQueueSize - 1)); }
+} // namespace
+
+namespace KeyEvents {
+
+void init() {
+    qHead = 0;
+    qTail = 0;
+    sDropped = 0;
+    sDeliveredMask = 0;
+    memset(sPressAccepted, 0, sizeof(sPressAccepted));
+}
+
+bool subscribe(Subscriber fn) {
+    if (!fn || sSubCount >= kMaxSubscribers) return false;
+    sSubs[sSubCount++] = fn;
+    return true;
+}
+
+bool publish(const KeyEvent& ev) {
+    if (ev.key >= kReleaseReserve) return false;
+    uint32_t& accepted = sPressAccepted[ev.key >> 5];
+    if (ev.kind == Kind::Release) {
+        if (!(accepted & pressBit(ev.key))) return false; // its Press was dropped: nothing sounds
+        accepted &= ~pressBit(ev.key);
+    }
+    uint16_t head = qHead;
+    const size_t used = (size_t)((head - qTail) & (kQueueSize - 1));
+    const size_t limit = (ev.kind == Kind::Release) ? kQueueSize - 1 : kQueueSize - 1 - kReleaseReserve;
+    if (used >= limit) {
+        sDropped++;
+        return false; // never block the scan
+    }
+    if (ev.kind == Kind::Press) accepted |= pressBit(ev.key);
+    qbuf[head] = ev;
+    qHead = nextIndex(head);
+    return true;
+}
+
+void service(uint16_t maxEvents) {
+    const uint8_t allMask = (uint8_t)((1u << sSubCount) - 1u);
+    while (maxEvents--) {
+        uint16_t tail = qTail;
+        if (tail == qHead) return;
+        const KeyEvent& ev = qbuf[tail];
+        for (uint8_t i = 0; i < sSubCount; ++i) {
+            const uint8_t bit = (uint8_t)(1u << i);
+            if (sDeliveredMask & bit) continue;
+            if (sSubs[i](ev)) sDeliveredMask |= bit;
+        }
+        // Backpressure: a subscriber refused, keep the event at the head for next time
+        if (sDeliveredMask != allMask) return;
+        sDeliveredMask = 0;
+        qTail = nextIndex(tail);
+    }
+}
+
+uint32_t droppedCount() { return sDropped; }
+
+} // namespace KeyEvents
@@ -0,0 +1,196 @@
+#include "key_health.h"
+#include "calibration.h"
+#include "key_state.h"
+#include "velocity_engine.h"
+
+namespace {
+struct Health {
+    uint16_t prev;       // last observed value (frozen check)
+    uint16_t sameObs;    // consecutive identical observations
+    uint16_t railObs;    // consecutive observations at a rail
+    uint16_t goodObs;    // consecutive observations without any fault
+    uint8_t  flags;
+};
+Health sHealth[N_MUX][N_CH];
+uint8_t  sExcludedMask[N_CH];   // bit mux set = key excluded (one byte per channel)
+uint8_t  sExcludedCount = 0;
+
+// Boot window statistics
+uint16_t sBootMin[N_MUX][N_CH];
+uint16_t sBootMax[N_MUX][N_CH];
+uint32_t sBootSum[N_MUX][N_CH];
+uint16_t sBootFrames = 0;
+bool     sBootActive = false;
+
+uint16_t sCursor = 0;
+uint32_t sLastVisitUs = 0;
+uint16_t sFrameNo = 0;          // scan plan: frames since boot (probe cadence)
+#if DEBUG_HEALTH_REPORT
+bool     sChanged = false;
+#endif
+
+inline bool atRail(int v) {
+    return v <= (int)kHealthRailCounts || v >= 1023 - (int)kHealthRailCounts;
+}
+
+// Apply a new flag set: exclusion follows kHealthExcludeMask
+void setFlags(uint8_t m, uint8_t c, uint8_t f) {
+    Health& h = sHealth[m][c];
+    if (f == h.flags) return;
+    h.flags = f;
+    const bool ex = (f & kHealthExcludeMask) != 0;
+    const bool was = (sExcludedMask[c] >> m) & 1u;
+    if (ex != was) {
+        if (ex) { sExcludedMask[c] |= (uint8_t)(1u << m); sExcludedCount++; }
+        else    { sExcludedMask[c] &= (uint8_t)~(1u << m); sExcludedCount--; }
+        VelocityEngine::setKeyExcluded(m, c, ex, micros());
+    }
+#if DEBUG_HEALTH_REPORT
+    sChanged = true;
+#endif
+}
+
+void finishBootCheck() {
+    sBootActive = false;
+    // Placeholder thresholds (board never calibrated): Low means nothing yet, only the swing
+    // itself can be checked
+    const bool calibrated = calibrationLoaded();
+    for (uint8_t m = 0; m < N_MUX; m++) {
+        for (uint8_t c = 0; c < N_CH; c++) {
+            const int mean = (int)(sBootSum[m][c] / sBootFrames);
+            const int low = (int)gThLow[m][c], high = (int)gThHigh[m][c];
+            const int s = (high >= low) ? +1 : -1;
+            uint8_t f = 0;
+            if (atRail(mean)) f |= KeyHealth::OutOfRange;
+            if (sBootMax[m][c] - sBootMin[m][c] > kHealthBootSpanCounts) f |= KeyHealth::Noisy;
+            // Nobody plays during boot: a key reading past Low is stuck, miswired or inverted
+            if (abs(high - low) < (int)Calib::kMinSwingCounts || (calibrated && s * (mean - low) >= 0)) f |= KeyHealth::Swing;
+            sHealth[m][c].prev = (uint16_t)mean;
+            setFlags(m, c, f);
+        }
+    }
+}
+
+// Background check of one key from its last sample
+void visit(uint8_t m, uint8_t c) {
+    Health& h = sHealth[m][c];
+    const KeyData& key = g_keys[m][c];
+    const int v = (int)key.last_adc;
+    const int low = (int)gThLow[m][c], high = (int)gThHigh[m][c];
+    const int s = (high >= low) ? +1 : -1;
+
+    // Rail: ignored on the pressed side of a sounding key (a deep press may reach it)
+    const bool pressedSide = s * (v - high) >= 0;
+    const bool rail = atRail(v) && !(key.note_on_sent && pressedSide);
+    h.railObs = rail ? (uint16_t)(h.railObs + (h.railObs < 0xFFFF)) : 0;
+    h.sameObs = (v == (int)h.prev) ? (uint16_t)(h.sameObs + (h.sameObs < 0xFFFF)) : 0;
+    h.prev = (uint16_t)v;
+
+    uint8_t now = 0;
+    if (h.railObs >= kHealthBadObs || ((h.flags & KeyHealth::OutOfRange) && rail)) now |= KeyHealth::OutOfRange;
+    if (h.sameObs >= kHealthFrozenObs) now |= KeyHealth::Frozen;
+    const uint8_t sq4 = gNoiseSigmaQ4[m][c];
+    if (sq4 > kHealthMaxSigmaQ4 || (sq4 == 0 && (h.flags & KeyHealth::Noisy))) now |= KeyHealth::Noisy;
+    // Swing: impossible thresholds, or (once flagged) still not back on the rest side
+    if (abs(high - low) < (int)Calib::kMinSwingCounts ||
+        ((h.flags & KeyHealth::Swing) && s * (v - low) >= 0)) now |= KeyHealth::Swing;
+
+    if (now & ~h.flags) {
+        h.goodObs = 0;
+        setFlags(m, c, (uint8_t)(h.flags | now));
+    } else if (now) {
+        h.goodObs = 0;
+    } else if (h.flags && ++h.goodObs >= kHealthRecoverObs) {
+        h.goodObs = 0;
+        setFlags(m, c, 0);
+    }
+}
+} // namespace
+
+namespace KeyHealth {
+
+void init() {
+    for (uint8_t m = 0; m < N_MUX; m++) {
+        for (uint8_t c = 0; c < N_CH; c++) {
+            sHealth[m][c] = Health{0, 0, 0, 0, 0};
+            sBootMin[m][c] = 0xFFFF;
+            sBootMax[m][c] = 0;
+            sBootSum[m][c] = 0;
+        }
+    }
+    for (uint8_t c = 0; c < N_CH; c++) sExcludedMask[c] = 0;
+    sExcludedCount = 0;
+    sBootFrames = 0;
+    sBootActive = kHealthMonitor;
+}
+
+bool bootCheckActive() { return sBootActive; }
+
+void frameIngest(const uint16_t frameValues[N_MUX][N_CH]) {
+    for (uint8_t m = 0; m < N_MUX; m++) {
+        for (uint8_t c = 0; c < N_CH; c++) {
+            const uint16_t v = frameValues[m][c];
+            if (v < sBootMin[m][c]) sBootMin[m][c] = v;
+            if (v > sBootMax[m][c]) sBootMax[m][c] = v;
+            sBootSum[m][c] += v;
+        }
+    }
+    if (++sBootFrames >= kHealthBootFrames) finishBootCheck();
+}
+
+void service(uint32_t nowUs) {
+    if (!kHealthMonitor || sBootActive) return;
+    if (nowUs - sLastVisitUs < kHealthVisitUs) return;
+    sLastVisitUs = nowUs;
+    for (uint8_t i = 0; i < kHealthKeysPerVisit; i++) {
+        visit((uint8_t)(sCursor / N_CH), (uint8_t)(sCursor % N_CH));
+        sCursor = (uint16_t)((sCursor + 1) % (N_MUX * N_CH));
+    }
+#if DEBUG_HEALTH_REPORT
+    static uint32_t sLastReportMs = 0;
+    const uint32_t nowMs = millis();
+    if (sChanged || nowMs - sLastReportMs >= DEBUG_HEALTH_REPORT_INTERVAL_MS) {
+        sChanged = false;
+        sLastReportMs = nowMs;
+        printReport();
+    }
+#endif
+}
+
+uint8_t nextScanChannel(uint8_t current) {
+    uint8_t next = (uint8_t)((current + 1) % N_CH);
+    if (next == 0) sFrameNo++;
+    // Full plan while calibrating (every key must be seen) and on probe frames (healing)
+    if (sExcludedCount < N_MUX || !calibrationUxIdle() || (sFrameNo % kHealthProbeFrames) == 0) return next;
+    for (uint8_t i = 0; i < N_CH && sExcludedMask[next] == 0xFF; i++) {
+        next = (uint8_t)((next + 1) % N_CH);
+        if (next == 0) sFrameNo++;
+        if ((sFrameNo % kHealthProbeFrames) == 0) break;
+    }
+    return next;
+}
+
+uint8_t flags(uint8_t mux, uint8_t ch) { return sHealth[mux][ch].flags; }
+bool excluded(uint8_t mux, uint8_t ch) { return (sExcludedMask[ch] >> mux) & 1u; }
+uint8_t excludedCount() { return sExcludedCount; }
+
+void printReport() {
+    uint8_t flagged = 0, dead = 0;
+    for (uint8_t c = 0; c < N_CH; c++) if (sExcludedMask[c] == 0xFF) dead++;
+    for (uint8_t m = 0; m < N_MUX; m++) {
+        for (uint8_t c = 0; c < N_CH; c++) {
+            const Health& h = sHealth[m][c];
+            if (!h.flags) continue;
+            flagged++;
+            Serial.printf("[HEALTH] m%u ch%u %s%s%s%s%s last=%u sigmaQ4=%u\n", m, c,
+                          (h.flags & OutOfRange) ? "RANGE " : "", (h.flags & Frozen) ? "FROZEN " : "",
+                          (h.flags & Noisy) ? "NOISY " : "", (h.flags & Swing) ? "SWING " : "",
+                          excluded(m, c) ? "(excluded)" : "(reported)",
+                          g_keys[m][c].last_adc, gNoiseSigmaQ4[m][c]);
+        }
+    }
+    Serial.printf("[HEALTH] %s flagged=%u excluded=%u deadChannels=%u\n",
+                  sBootActive ? "boot-check" : "ok", flagged, sExcludedCount, dead);
+}
+
+} // namespace KeyHealth
@@ -13,13 +13,23 @@
 #include "key_state.h"
 #include "calibration.h"
 #include "midi_out.h"
+#include "midi_din.h"
+#include "sysex_config.h"
+#include "baseline_tracker.h"
+#include "key_health.h"
+#include "temp_comp.h"
+#include "key_events.h"
+#include "note_output.h"
+#include "velocity_eq.h"
+#include "velocity_curves.h"
 #include <imxrt.h>  // pour DWT cycle counter (Teensy 4.x)
 #if DEBUG_ADC_MONITOR
 #include "adc_monitor.h"
 #endif
 
-// === Runtime velocity gamma (adjustable via encoder) ===
-float gVelocityGamma = kVelocityGammaDefault;
+// === Runtime scan timing (SysEx) ===
+uint32_t gScanSettleMicros = kSettleMicros;
+uint32_t gScanPairDelayCycles = kPerPairDelayCycles;
 
 // === ADC Instance ===
 static ADC gAdc;
@@ -175,11 +185,13 @@ void scanChannelDualADC(uint8_t channel) {
     channel = DEBUG_FREEZE_CHANNEL % N_CH;
     #endif
 
+    // ADC conversion window: no MIDI drain interrupt until the 4 pairs are read
+    MidiOut::deferDrain();
     // Set MUX channel with ultra-fast LUT (both groups simultaneously)
     setMuxChannel(channel);
 
     // Allow MUX outputs + sample/hold buffers to settle
-    delayMicroseconds(kSettleMicros);
+    delayMicroseconds(gScanSettleMicros);
 
     // Timestamp as close as possible to first acquisition (pre-loop)
     uint32_t timestamp_us = micros();
@@ -212,21 +224,22 @@ void scanChannelDualADC(uint8_t channel) {
             // Pause optionnelle entre paires pour éviter des lectures clonées.
             if (kPerPairDelayMicros > 0) {
                 delayMicroseconds(kPerPairDelayMicros);
-            } else if (kPerPairDelayCycles > 0) {
+            } else if (gScanPairDelayCycles > 0) {
                 // Attente fine en cycles CPU
                 uint32_t start = readCycleCounter();
-                while ((readCycleCounter() - start) < kPerPairDelayCycles) { __asm__ volatile("nop"); }
+                while ((readCycleCounter() - start) < gScanPairDelayCycles) { __asm__ volatile("nop"); }
             }
         }
+    MidiOut::resumeDrain();
 
-    // Process all 8 keys (always active; no calibration phase)
-    for (uint8_t mux = 0; mux < 8; mux++) {
-        VelocityEngine::processKey(mux, channel, values[mux], timestamp_us);
+    // Process all 8 keys: resting IDLE keys are prefiltered with packed 16-bit compares
+    VelocityEngine::processChannel(channel, values, timestamp_us);
 #if DEBUG_ADC_MONITOR
+    for (uint8_t mux = 0; mux < 8; mux++) {
         // Met à jour le moniteur si c'est la combinaison surveillée
         AdcMonitor::updateIfMatch(mux, channel, values[mux], timestamp_us);
-#endif
     }
+#endif
 
 #if DEBUG_DUPLICATE_DETECT
     // Détection duplication: compare valeurs[0..3] vs valeurs[4..7]
@@ -279,16 +292,29 @@ void setup() {
     VelocityEngine::initialize();
     // Initialize MIDI output queue
     MidiOut::init();
+    // Key event bus + subscribers (MIDI notes)
+    KeyEvents::init();
+    NoteOutput::init();
+    // Config record read and verified once (every module below loads from the RAM image)
+    EepromStore::begin();
     // Init static thresholds (Phase1 dynamique) and load velocity gamma from EEPROM
     calibrationInitStatic();
-    // Load velocity gamma from EEPROM if available
-    {
-        uint16_t tmpLow[N_MUX][N_CH], tmpHigh[N_MUX][N_CH];
-        float tmpGamma = kVelocityGammaDefault;
-        if (EepromStore::load(tmpLow, tmpHigh, &tmpGamma)) {
-            gVelocityGamma = tmpGamma;
-        }
-    }
+    // Prefilter bands depend on the thresholds just loaded
+    VelocityEngine::refreshAllQuietBands();
+    // Per-key velocity equalization learned from playing
+    VelocityEq::init();
+    // Rest drift tracking anchored on the thresholds just loaded
+    BaselineTracker::init();
+    // Sensor health: boot check over the first frames, then background monitoring
+    KeyHealth::init();
+    // Temperature compensation (die temperature → per-key threshold model)
+    TempComp::init();
+    // Velocity curves (gamma curve compiled from the gamma just loaded, per-key assignment)
+    VelocityCurves::init();
+    // Note layout (flat key→note table, transpose folded in)
+    noteMapInit();
+    // SysEx configuration protocol (after every module it reads or writes)
+    SysexConfig::init();
     // Set LED brightness to constant value (no longer adjustable via encoder)
     simpleLedsSetBrightness(kLedBrightness);
     // Ne pas démarrer de calibration au boot: conserver les seuils EEPROM
@@ -321,13 +347,19 @@ void loop() {
         gChannelSamples++;
         if (chDur > gChannelMaxUs) gChannelMaxUs = chDur;
 #endif
-        currentChannel = (currentChannel + 1) % N_CH;
-        if (currentChannel == 0) {
+        // Scan plan: channels whose 8 sensors are all excluded are skipped (periodic probe frame)
+        const uint8_t nextChannel = KeyHealth::nextScanChannel(currentChannel);
+        const bool frameDone = nextChannel <= currentChannel;
+        currentChannel = nextChannel;
+        if (frameDone) {
             g_acquisition.swapBuffers();
             // Phase2 ingestion frame pour médiane Low
             if (calibrationIsCollecting()) {
                 calibrationFrameIngest(g_acquisition.workingValues); // workingValues encore valides juste après swap
             }
+            if (KeyHealth::bootCheckActive()) {
+                KeyHealth::frameIngest(g_acquisition.workingValues);
+            }
 #if DEBUG_PROFILE_SCAN
             uint32_t nowUsFrame = micros();
             uint32_t frameDur = nowUsFrame - gFrameStartUs;
@@ -338,12 +370,16 @@ void loop() {
                 // Calculs moyens
                 uint32_t avgFrameUs = gFrameAccumTimeUs / gFrameSamples;
                 uint32_t avgChannelUs = gChannelSamples ? (uint32_t)(gAccumChannelTimeUs / gChannelSamples) : 0;
-                Serial.printf("[PROFILE] frames=%lu avgFrame=%luus avgCh=%luus maxCh=%luus fps_est=%lu\n",
+                uint32_t fsmRuns = 0, quietSkips = 0;
+                VelocityEngine::takeProfileCounters(fsmRuns, quietSkips);
+                Serial.printf("[PROFILE] frames=%lu avgFrame=%luus avgCh=%luus maxCh=%luus fps_est=%lu fsm=%lu quiet=%lu\n",
                               (unsigned long)gFrameSamples,
                               (unsigned long)avgFrameUs,
                               (unsigned long)avgChannelUs,
                               (unsigned long)gChannelMaxUs,
-                              (unsigned long)(avgFrameUs ? (1000000UL / avgFrameUs) : 0));
+                              (unsigned long)(avgFrameUs ? (1000000UL / avgFrameUs) : 0),
+                              (unsigned long)fsmRuns,
+                              (unsigned long)quietSkips);
                 // reset interval
                 gFrameAccumTimeUs = 0;
                 gFrameSamples = 0;
@@ -367,8 +403,6 @@ void loop() {
 #endif
     // Flush LED strip une seule fois par frame (si changement)
     simpleLedsFrameFlush();
-    // MIDI: drain queue avec budget court, une seule fois par frame
-    MidiOut::service(50);
 #if DEBUG_DUPLICATE_DETECT
     gFramesSinceDupPrint++;
     if (gFramesSinceDupPrint >= DEBUG_DUPLICATE_PRINT_INTERVAL_FRAMES) {
@@ -395,12 +429,17 @@ void loop() {
         gChannelSamples++;
         if (chDur > gChannelMaxUs) gChannelMaxUs = chDur;
 #endif
-        currentChannel = (currentChannel + 1) % N_CH;
-        if (currentChannel == 0) {
+        const uint8_t nextChannel = KeyHealth::nextScanChannel(currentChannel);
+        const bool frameDone = nextChannel <= currentChannel;
+        currentChannel = nextChannel;
+        if (frameDone) {
             g_acquisition.swapBuffers();
             if (calibrationIsCollecting()) {
                 calibrationFrameIngest(g_acquisition.workingValues);
             }
+            if (KeyHealth::bootCheckActive()) {
+                KeyHealth::frameIngest(g_acquisition.workingValues);
+            }
 #if DEBUG_PROFILE_SCAN
             uint32_t nowUsFrame = micros();
             uint32_t frameDur = nowUsFrame - gFrameStartUs;
@@ -410,12 +449,16 @@ void loop() {
             if (gFrameSamples >= DEBUG_PROFILE_INTERVAL_FRAMES) {
                 uint32_t avgFrameUs = gFrameAccumTimeUs / gFrameSamples;
                 uint32_t avgChannelUs = gChannelSamples ? (uint32_t)(gAccumChannelTimeUs / gChannelSamples) : 0;
-                Serial.printf("[PROFILE] frames=%lu avgFrame=%luus avgCh=%luus maxCh=%luus fps_est=%lu\n",
+                uint32_t fsmRuns = 0, quietSkips = 0;
+                VelocityEngine::takeProfileCounters(fsmRuns, quietSkips);
+                Serial.printf("[PROFILE] frames=%lu avgFrame=%luus avgCh=%luus maxCh=%luus fps_est=%lu fsm=%lu quiet=%lu\n",
                               (unsigned long)gFrameSamples,
                               (unsigned long)avgFrameUs,
                               (unsigned long)avgChannelUs,
                               (unsigned long)gChannelMaxUs,
-                              (unsigned long)(avgFrameUs ? (1000000UL / avgFrameUs) : 0));
+                              (unsigned long)(avgFrameUs ? (1000000UL / avgFrameUs) : 0),
+                              (unsigned long)fsmRuns,
+                              (unsigned long)quietSkips);
                 gFrameAccumTimeUs = 0;
                 gFrameSamples = 0;
                 gAccumChannelTimeUs = 0;
@@ -437,8 +480,6 @@ void loop() {
 #endif
     // Flush LED strip une seule fois par frame (si changement)
     simpleLedsFrameFlush();
-    // MIDI: drain queue avec budget court, une seule fois par frame
-    MidiOut::service(50);
 #if DEBUG_DUPLICATE_DETECT
     gFramesSinceDupPrint++;
     if (gFramesSinceDupPrint >= DEBUG_DUPLICATE_PRINT_INTERVAL_FRAMES) {
@@ -457,6 +498,55 @@ void loop() {
     }
 
     // === Handle other tasks ===
+    // Dispatch key events to outputs (outside the scan, a few events per iteration)
+    // (interrupt drain: the batch is released at once, a chord leaves in one transfer)
+    MidiOut::deferDrain();
+    KeyEvents::service(16);
+    MidiOut::resumeDrain();
+    // MIDI: writer groupé, au plus un envoi USB par microframe (125 µs)
+    MidiOut::service(50);
+    // DIN: servi séparément, n'écrit que ce que l'UART accepte sans bloquer
+    if (kMidiDinEnabled) MidiDin::service();
+    // SysEx: lecture USB bornée, une commande / un message de réponse par tour
+    SysexConfig::service();
+#if DEBUG_VELOCITY_COMPARE
+    VelocityEngine::dumpVelocityCompare();
+#endif
+#if DEBUG_MIDI_STATS
+    {
+        static uint32_t sLastMidiStatsMs = 0;
+        const uint32_t nowMs = millis();
+        if (nowMs - sLastMidiStatsMs >= DEBUG_MIDI_STATS_INTERVAL_MS) {
+            sLastMidiStatsMs = nowMs;
+            MidiOut::Stats st;
+            MidiOut::takeStats(st);
+            if (st.packets || st.txDropped) {
+                Serial.printf("[MIDI] packets=%lu events=%lu avgPerPkt=%.2f maxPerPkt=%u avgLat=%luus minLat=%luus maxLat=%luus late=%lu "
+                              "noteHW=%u noteDrop=%lu offDefer=%lu contHW=%u coalesced=%lu contDrop=%lu txDrop=%lu\n",
+                              (unsigned long)st.packets, (unsigned long)st.events,
+                              st.packets ? (double)st.events / (double)st.packets : 0.0, st.maxPerPacket,
+                              (unsigned long)(st.events ? st.latencySumUs / st.events : 0),
+                              (unsigned long)st.latencyMinUs,
+                              (unsigned long)st.latencyMaxUs,
+                              (unsigned long)st.late,
+                              st.noteHighWater, (unsigned long)st.noteDropped,
+                              (unsigned long)st.noteOffDeferred, st.contHighWater,
+                              (unsigned long)st.coalesced, (unsigned long)st.contDropped,
+                              (unsigned long)st.txDropped);
+            }
+        }
+    }
+#endif
+#if DEBUG_NOISE_REPORT
+    {
+        static uint32_t sLastNoiseMs = 0;
+        const uint32_t nowMs = millis();
+        if (nowMs - sLastNoiseMs >= DEBUG_NOISE_REPORT_INTERVAL_MS) {
+            sLastNoiseMs = nowMs;
+            BaselineTracker::printNoiseReport();
+        }
+    }
+#endif
     // USB MIDI is handled automatically
     // (LEDs déjà flush en fin de frame si nécessaire)
 
@@ -474,20 +564,26 @@ void loop() {
             // Clamp to reasonable range 0.05..2.0
             if (gVelocityGamma < 0.05f) gVelocityGamma = 0.05f;
             if (gVelocityGamma > 2.0f) gVelocityGamma = 2.0f;
+            VelocityCurves::rebuildGamma();
 #if DEBUG_GAMMA_MONITOR
             Serial.printf("VelocityGamma=%.3f\n", gVelocityGamma);
 #endif
         }
         // Button 24 clicks: short/double saves gamma, triple resets
         if (rs.btn24Click == IoState::Btn24Click::Short || rs.btn24Click == IoState::Btn24Click::Double) {
-            // Save current gamma to EEPROM
-            EepromStore::save(gThLow, gThHigh, &gVelocityGamma);
+            // Save current gamma to EEPROM (+ learned per-key velocity equalization):
+            // snapshots only, written a few bytes per loop by EepromStore::service
+            calibrationSaveToEeprom();
+            VelocityEq::save();
+            VelocityCurves::save();
+            noteMapSave();
 #if DEBUG_GAMMA_MONITOR
             Serial.printf("VelocityGamma=%.3f [SAVED to EEPROM]\n", gVelocityGamma);
 #endif
         } else if (rs.btn24Click == IoState::Btn24Click::Triple) {
             // Reset gamma to default
             gVelocityGamma = kVelocityGammaDefault;
+            VelocityCurves::rebuildGamma();
 #if DEBUG_GAMMA_MONITOR
             Serial.printf("VelocityGamma=%.3f [RESET to default]\n", gVelocityGamma);
 #endif
@@ -497,12 +593,37 @@ void loop() {
 #if DEBUG_ADC_MONITOR
     AdcMonitor::printPeriodic();
 #endif
+    // Recompute per-key velocity gains when new notes were learned (rate-limited)
+    VelocityEq::service(millis());
+    // Idle-key rest drift → Low (a few keys per ms, occasional background save)
+    BaselineTracker::service(micros(), millis());
+    // Sensor health (dead/stuck/noisy keys excluded from the FSM and the scan plan)
+    KeyHealth::service(micros());
+    // Temperature model: 1 Hz sampling, slow learning, small threshold steps
+    TempComp::service(millis());
     // Service calibration (finalisation médiane)
     calibrationService();
     // Service calibration UX FSM (button 24 control)
     // We call with current millis() and button-24 state exposed by IoState.
     // Use last rocker status cached in rs if available, else poll quickly here.
     calibrationServiceFSM(millis(), rs.button24Low);
+    // Background EEPROM save (a few bytes per iteration)
+    EepromStore::service(kEepromBytesPerLoop);
+#if DEBUG_LOOP_TIME
+    {
+        static uint32_t sLoopMaxUs = 0;
+        static uint32_t sLoopReportMs = 0;
+        const uint32_t loopUs = micros() - nowUs;
+        if (loopUs > sLoopMaxUs) sLoopMaxUs = loopUs;
+        const uint32_t nowMs = millis();
+        if (nowMs - sLoopReportMs >= DEBUG_LOOP_TIME_INTERVAL_MS) {
+            Serial.printf("[LOOP] max=%luus calib=%d\n", (unsigned long)sLoopMaxUs,
+                          calibrationUxIdle() ? 0 : 1);
+            sLoopReportMs = nowMs;
+            sLoopMaxUs = 0;
+        }
+    }
+#endif
 }
 
 // (Calibration helper functions removed)
@@ -0,0 +1,216 @@
+#include "midi_din.h"
+#include "config.h"
+
+namespace {
+// Note ring (single thread: main loop produces and consumes)
+constexpr uint16_t kQueueSize = kDinQueueSize; // power of two
+static_assert((kQueueSize & (kQueueSize - 1)) == 0, "kDinQueueSize must be a power of two");
+MidiOut::Event qbuf[kQueueSize];
+uint16_t qHead = 0;
+uint16_t qTail = 0;
+
+// NoteOff that did not fit in the ring: one bit per (channel, note). While any is pending the
+// ring is full; they move back into the ring ahead of anything newer as soon as a slot frees.
+uint32_t sOffOverflow[16][4];
+uint16_t sOffOverflowCount = 0;
+
+// Continuous data: latest value per (kind, channel, controller)
+constexpr uint8_t kContSlots = 32;
+struct ContSlot { uint16_t key; MidiOut::Event ev; };
+ContSlot sCont[kContSlots];
+uint32_t sContPending = 0;
+uint32_t sLastContUs = 0;
+
+uint8_t sRunningStatus = 0;   // 0 = none
+uint32_t sLastStatusMs = 0;
+
+MidiDin::ByteSink sSink = {nullptr, nullptr};
+MidiDin::Stats sStats = {};
+
+inline uint16_t nextIndex(uint16_t i) { return (uint16_t)((i + 1) & (kQueueSize - 1)); }
+inline uint16_t used() { return (uint16_t)((qHead - qTail) & (kQueueSize - 1)); }
+
+inline bool isContinuous(MidiOut::Kind k) {
+    return k == MidiOut::Kind::CC || k == MidiOut::Kind::ChannelPressure;
+}
+
+inline uint16_t contKey(const MidiOut::Event& ev) {
+    const uint8_t ctl = (ev.kind == MidiOut::Kind::CC) ? ev.d1 : 0;
+    return (uint16_t)(((uint16_t)ev.kind << 12) | ((uint16_t)((ev.ch - 1) & 0x0F) << 8) | ctl);
+}
+
+#if defined(CORE_TEENSY)
+int serialAvailable() { return kMidiDinSerial.availableForWrite(); }
+void serialWrite(uint8_t b) { kMidiDinSerial.write(b); }
+#endif
+
+// Encode one message with running status; false if the line cannot take it right now
+bool writeMessage(const MidiOut::Event& ev) {
+    uint8_t status;
+    uint8_t d1 = ev.d1, d2 = ev.d2;
+    uint8_t len = 2;
+    const uint8_t ch = (uint8_t)((ev.ch - 1) & 0x0F);
+    switch (ev.kind) {
+        case MidiOut::Kind::NoteOn:  status = 0x90 | ch; break;
+        case MidiOut::Kind::NoteOff:
+            if (kDinNoteOffAsZeroVelocity) { status = 0x90 | ch; d2 = 0; }
+            else status = 0x80 | ch;
+            break;
+        case MidiOut::Kind::CC:      status = 0xB0 | ch; break;
+        case MidiOut::Kind::ChannelPressure: status = 0xD0 | ch; len = 1; break;
+        default: return true;
+    }
+    // Re-send the status byte now and then: a receiver plugged in mid-stream resyncs
+    const uint32_t nowMs = millis();
+    if (nowMs - sLastStatusMs >= kDinRunningStatusRefreshMs) sRunningStatus = 0;
+    const bool sendStatus = (status != sRunningStatus);
+    const int need = len + (sendStatus ? 1 : 0);
+    if (sSink.availableForWrite() < need) return false;
+    if (sendStatus) {
+        sSink.write(status);
+        sRunningStatus = status;
+        sLastStatusMs = nowMs;
+    } else {
+        sStats.runningStatusSaved++;
+    }
+    sSink.write(d1 & 0x7F);
+    if (len == 2) sSink.write(d2 & 0x7F);
+    sStats.bytes += (uint32_t)need;
+    sStats.messages++;
+    return true;
+}
+
+// Chord ordering: among the NoteOns waiting back to back at the tail, the loudest goes first
+void promoteLoudestNoteOn() {
+    if (qbuf[qTail].kind != MidiOut::Kind::NoteOn) return;
+    uint16_t best = qTail;
+    uint8_t n = 0;
+    for (uint16_t i = nextIndex(qTail); i != qHead && n < kDinChordWindow; i = nextIndex(i), n++) {
+        if (qbuf[i].kind != MidiOut::Kind::NoteOn) break;
+        if (qbuf[i].d2 > qbuf[best].d2) best = i;
+    }
+    if (best != qTail) {
+        const MidiOut::Event t = qbuf[qTail];
+        qbuf[qTail] = qbuf[best];
+        qbuf[best] = t;
+    }
+}
+
+// Deferred NoteOffs back into the ring, before any newer event (a NoteOn of the same pitch
+// queued later can never be cut by its older NoteOff)
+void refillFromOverflow() {
+    for (uint8_t ch = 0; ch < 16 && sOffOverflowCount; ch++) {
+        for (uint8_t w = 0; w < 4; w++) {
+            while (sOffOverflow[ch][w]) {
+                if (nextIndex(qHead) == qTail) return;
+                const uint8_t bit = (uint8_t)__builtin_ctz(sOffOverflow[ch][w]);
+                qbuf[qHead] = MidiOut::Event{MidiOut::Kind::NoteOff, (uint8_t)(ch + 1), (uint8_t)(w * 32 + bit), 0};
+                qHead = nextIndex(qHead);
+                sOffOverflow[ch][w] &= ~(1u << bit);
+                sOffOverflowCount--;
+            }
+        }
+    }
+}
+
+// FIFO ring, behind the deferred NoteOffs. A NoteOff that does not fit is deferred, anything
+// else is lost (counted).
+void pushRing(const MidiOut::Event& ev) {
+    if (sOffOverflowCount) refillFromOverflow();
+    if (nextIndex(qHead) == qTail) {
+        if (ev.kind == MidiOut::Kind::NoteOff) {
+            uint32_t& word = sOffOverflow[(ev.ch - 1) & 0x0F][(ev.d1 >> 5) & 3];
+            const uint32_t bit = 1u << (ev.d1 & 31);
+            if (!(word & bit)) { word |= bit; sOffOverflowCount++; }
+            sStats.noteOffDeferred++;
+        } else {
+            sStats.noteOnDropped++;
+        }
+        return;
+    }
+    qbuf[qHead] = ev;
+    qHead = nextIndex(qHead);
+    if (used() > sStats.queueHighWater) sStats.queueHighWater = used();
+}
+} // namespace
+
+namespace MidiDin {
+
+void init() {
+    qHead = qTail = 0;
+    memset(sOffOverflow, 0, sizeof(sOffOverflow));
+    sOffOverflowCount = 0;
+    sContPending = 0;
+    sRunningStatus = 0;
+    sStats = Stats{};
+#if defined(CORE_TEENSY)
+    if (!sSink.write) {
+        kMidiDinSerial.begin(31250);
+        sSink = ByteSink{serialAvailable, serialWrite};
+    }
+#endif
+}
+
+void setSink(const ByteSink& sink) {
+    sSink = sink;
+    sRunningStatus = 0; // new line: first message carries its status
+}
+
+void enqueue(const MidiOut::Event& ev) {
+    if (isContinuous(ev.kind)) {
+        const uint16_t key = contKey(ev);
+        uint32_t m = sContPending;
+        while (m) {
+            const uint8_t i = (uint8_t)__builtin_ctz(m);
+            if (sCont[i].key == key) { sCont[i].ev = ev; sStats.contThinned++; return; }
+            m &= m - 1;
+        }
+        if (sContPending == 0xFFFFFFFFu) { sStats.contThinned++; return; }
+        const uint8_t i = (uint8_t)__builtin_ctz(~sContPending);
+        sCont[i] = ContSlot{key, ev};
+        sContPending |= (1u << i);
+        return;
+    }
+    pushRing(ev);
+}
+
+void enqueueInOrder(const MidiOut::Event& ev) {
+    // Ordered with the notes (MPE per-note state before its NoteOn): FIFO ring, and a pending
+    // coalesced value of the same controller is superseded
+    if (isContinuous(ev.kind)) {
+        const uint16_t key = contKey(ev);
+        uint32_t m = sContPending;
+        while (m) {
+            const uint8_t i = (uint8_t)__builtin_ctz(m);
+            if (sCont[i].key == key) { sContPending &= ~(1u << i); break; }
+            m &= m - 1;
+        }
+    }
+    pushRing(ev);
+}
+
+void service() {
+    if (!sSink.write || !sSink.availableForWrite) return;
+    // Notes first, as many as the UART buffer takes without blocking
+    while (qHead != qTail) {
+        promoteLoudestNoteOn();
+        if (!writeMessage(qbuf[qTail])) return;
+        qTail = nextIndex(qTail);
+        if (sOffOverflowCount) refillFromOverflow();
+    }
+    // Continuous data only on an idle note queue, rate-limited
+    if (!sContPending) return;
+    const uint32_t now = micros();
+    if (now - sLastContUs < kDinContMinGapUs) return;
+    const uint8_t i = (uint8_t)__builtin_ctz(sContPending);
+    if (!writeMessage(sCont[i].ev)) return;
+    sContPending &= ~(1u << i);
+    sLastContUs = now;
+}
+
+void takeStats(Stats& out) {
+    out = sStats;
+    sStats = Stats{};
+}
+
+} // namespace MidiDin
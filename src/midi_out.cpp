@@ -1,17 +1,117 @@
 #include "midi_out.h"
 #include <usb_midi.h>
+#include <usb_dev.h>
+#include <imxrt.h>
+#include <EventResponder.h>
+#include "config.h"
+#include "midi_din.h"
 
 namespace {
-// Simple SPSC ring buffer
-constexpr size_t kQueueSize = 128; // power of two for cheap masking
+// Note ring: simple SPSC ring buffer
+constexpr size_t kQueueSize = 256; // power of two for cheap masking
 MidiOut::Event qbuf[kQueueSize];
+uint32_t qTime[kQueueSize];  // enqueue timestamp (micros) for queue-to-wire latency
 volatile uint16_t qHead = 0; // write index
 volatile uint16_t qTail = 0; // read index
 
+// USB never refuses an event (DIN is fed by the same calls and must not wait on USB): with the
+// ring full, a NoteOff is deferred here, one bit per (channel, note), and moved back into the
+// ring ahead of anything newer by the producer side; any other event is dropped (counted).
+uint32_t sOffOverflow[16][4];
+uint16_t sOffOverflowCount = 0;
+
+// Continuous data: coalescing table, one slot per (kind, channel, controller)
+constexpr uint8_t kContSlots = 32;
+struct ContSlot {
+    uint16_t key;
+    MidiOut::Event ev;
+    uint32_t t_us; // first enqueue of the pending value (latency of the oldest unsent update)
+};
+ContSlot sCont[kContSlots];
+uint32_t sContPending = 0; // bit i = slot i holds an unsent value
+
+// SysEx slot (configuration replies): filled by the main loop, emptied by the writer
+uint8_t sSysex[MidiOut::kSysexMax];
+volatile uint16_t sSysexLen = 0; // 0 = free
+
+uint32_t sLastFlushFrame = 0xFFFFFFFFu;
+uint32_t sLastFlushUs = 0;
+// FRINDEX only advances with host SOFs: without a host (or while suspended) it stands still and
+// the writer falls back to micros(), so the ring keeps draining instead of backing up the scan
+constexpr uint32_t kFrameFallbackUs = 1000;
+MidiOut::Stats sStats = {};
+
+// Constant-latency scheduler (0 = off)
+IntervalTimer sLatencyTimer;
+volatile uint32_t sHoldUs = 0;
+
+// USB transmit side as seen by a drain running in interrupt context. When the core has no free
+// TX buffer, a usbMIDI write busy-waits up to its timeout and calls yield(): never from an ISR.
+// Ready: no transfer in flight on the MIDI IN endpoint, so every core TX buffer is free.
+// Busy: a transfer is still waiting for the host, retry later.
+// Gone: no host configured, or one that has not read anything for kTxStallUs: discard.
+enum class TxState : uint8_t { Ready, Busy, Gone };
+constexpr uint32_t kTxEndpointBit = 1u << (16 + MIDI_TX_ENDPOINT);
+constexpr uint32_t kTxStallUs = 20000;
+// Packets per drain: stays within the free TX buffers (16 packets each at full speed)
+constexpr uint16_t kTxMaxPackets = 48;
+bool sTxBusy = false;
+uint32_t sTxBusySinceUs = 0;
+
+// Interrupt drain: software interrupt (EventResponder) raised on enqueue, held off by
+// deferDrain() windows
+constexpr bool kDrainIsr = (MIDI_DRAIN_ISR != 0);
+EventResponder sDrainEvent;
+volatile uint8_t sDeferDepth = 0;
+volatile bool sDrainPending = false;
+
 inline uint16_t nextIndex(uint16_t idx) { return static_cast<uint16_t>((idx + 1) & (kQueueSize - 1)); }
 inline bool isFull(uint16_t head, uint16_t tail) { return nextIndex(head) == tail; }
 inline bool isEmpty(uint16_t head, uint16_t tail) { return head == tail; }
 
+inline bool isContinuous(MidiOut::Kind k) {
+    return k == MidiOut::Kind::CC || k == MidiOut::Kind::ChannelPressure;
+}
+
+// Coalescing key: the controller identity, not its value
+inline uint16_t contKey(const MidiOut::Event& ev) {
+    const uint8_t ctl = (ev.kind == MidiOut::Kind::CC) ? ev.d1 : 0;
+    return (uint16_t)(((uint16_t)ev.kind << 12) | ((uint16_t)((ev.ch - 1) & 0x0F) << 8) | ctl);
+}
+
+inline int8_t findPending(uint16_t key) {
+    uint32_t m = sContPending;
+    while (m) {
+        const uint8_t i = (uint8_t)__builtin_ctz(m);
+        if (sCont[i].key == key) return (int8_t)i;
+        m &= m - 1;
+    }
+    return -1;
+}
+
+// Current USB microframe: FRINDEX counts 125 µs microframes while the high-speed link is up
+// (bits 2..0 = microframe, 13..3 = frame). Host builds fall back to micros().
+inline uint32_t currentMicroframe() {
+#if defined(USB1_FRINDEX)
+    return USB1_FRINDEX & 0x3FFF;
+#else
+    return micros() / 125u;
+#endif
+}
+
+TxState txState(uint32_t now) {
+    if (!usb_configuration) return TxState::Gone;
+    if (((USB1_ENDPTSTAT | USB1_ENDPTPRIME) & kTxEndpointBit) == 0) {
+        sTxBusy = false;
+        return TxState::Ready;
+    }
+    if (!sTxBusy) {
+        sTxBusy = true;
+        sTxBusySinceUs = now;
+    }
+    return (now - sTxBusySinceUs >= kTxStallUs) ? TxState::Gone : TxState::Busy;
+}
+
 void sendEvent(const MidiOut::Event& ev) {
     switch (ev.kind) {
         case MidiOut::Kind::NoteOn:
@@ -23,55 +123,272 @@ void sendEvent(const MidiOut::Event& ev) {
         case MidiOut::Kind::CC:
             usbMIDI.sendControlChange(ev.d1, ev.d2, ev.ch);
             break;
+        case MidiOut::Kind::ChannelPressure:
+            usbMIDI.sendAfterTouch(ev.d1, ev.ch);
+            break;
     }
 }
-} // namespace
 
-namespace MidiOut {
+inline void accountLatency(uint32_t start, uint32_t t_us) {
+    const uint32_t lat = start - t_us;
+    sStats.latencySumUs += lat;
+    if (lat < sStats.latencyMinUs) sStats.latencyMinUs = lat;
+    if (lat > sStats.latencyMaxUs) sStats.latencyMaxUs = lat;
+}
 
-void init() {
-    // nothing yet
+// Write every note due at now (timestamp + holdUs), then the due controllers, into one
+// transfer. Returns the number of events written (send_now() issued if > 0). discard: no host
+// to write to, the due events are dropped (counted), never left to pile up.
+uint16_t drain(uint32_t now, uint32_t holdUs, uint32_t budgetUs, bool discard) {
+    uint16_t batch = 0;
+    uint16_t packets = 0;
+    bool budgetLeft = true;
+    // Notes first: pack everything due (or until the time or packet budget is spent)
+    while (true) {
+        uint16_t head = qHead; // snapshot
+        uint16_t tail = qTail;
+        if (isEmpty(head, tail)) break;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE); // slot contents published before qHead
+        if (packets >= kTxMaxPackets) { budgetLeft = false; break; }
+        const uint32_t age = now - qTime[tail];
+        if (age < holdUs) break; // FIFO: later notes are not due either
+        if (holdUs && age >= holdUs + kConstLatencyTickUs) sStats.late++;
+        const MidiOut::Event ev = qbuf[tail];
+        const uint32_t t = qTime[tail];
+        qTail = nextIndex(tail);
+        if (discard) { sStats.txDropped++; continue; }
+        accountLatency(now, t);
+        sendEvent(ev);
+        batch++;
+        packets++;
+        if ((micros() - now) >= budgetUs) { budgetLeft = false; break; }
+    }
+    // Then the latest value of each pending controller, held like the notes (from its oldest
+    // unsent update): a per-note pressure never leaves ahead of its NoteOn
+    uint32_t pending = sContPending;
+    while (budgetLeft && pending && packets < kTxMaxPackets) {
+        const uint8_t i = (uint8_t)__builtin_ctz(pending);
+        pending &= pending - 1;
+        const uint32_t age = now - sCont[i].t_us;
+        if (age < holdUs) continue;
+        if (holdUs && age >= holdUs + kConstLatencyTickUs) sStats.late++;
+        sContPending &= ~(1u << i);
+        if (discard) { sStats.txDropped++; continue; }
+        accountLatency(now, sCont[i].t_us);
+        sendEvent(sCont[i].ev);
+        batch++;
+        packets++;
+        if ((micros() - now) >= budgetUs) { budgetLeft = false; break; }
+    }
+    // SysEx last, and only behind an empty note ring: a reply never delays a NoteOn
+    const uint16_t sysexLen = sSysexLen;
+    if (budgetLeft && sysexLen && isEmpty(qHead, qTail) && packets + (sysexLen + 2u) / 3u <= kTxMaxPackets) {
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (!discard) usbMIDI.sendSysEx(sysexLen, sSysex, true);
+        sSysexLen = 0;
+        batch += !discard;
+    }
+    if (batch) {
+        usbMIDI.send_now();
+        sStats.packets++;
+        sStats.events += batch;
+        if (batch > sStats.maxPerPacket) sStats.maxPerPacket = batch;
+    }
+    return batch;
+}
+
+// Constant-latency tick (IntervalTimer ISR, lowest priority): sole USB writer in this mode.
+// Writes only when the core has free TX buffers; otherwise the next tick retries (late events
+// are counted).
+void latencyTick() {
+    const uint32_t now = micros();
+    const TxState tx = txState(now);
+    if (tx == TxState::Busy) return;
+    drain(now, sHoldUs, kConstLatencyTickUs, tx == TxState::Gone);
 }
 
-bool enqueue(const Event& ev) {
+// Software interrupt: sole USB writer in interrupt drain mode. Same rule as the scheduler
+// tick: no write while the core's TX buffers are busy (service() re-raises the drain)
+void drainHandler(EventResponder&) {
+    if (sDeferDepth) { sDrainPending = true; return; }
+    sDrainPending = false;
+    const uint32_t now = micros();
+    const TxState tx = txState(now);
+    if (tx == TxState::Busy) return;
+    drain(now, 0, kMidiDrainBudgetUs, tx == TxState::Gone);
+}
+
+// Producer side: run the drain now, or at the end of the current defer window
+inline void requestDrain() {
+    if (!kDrainIsr || sHoldUs) return;
+    if (sDeferDepth) { sDrainPending = true; return; }
+    sDrainEvent.triggerEvent();
+}
+
+void resetStats() {
+    sStats = MidiOut::Stats{};
+    sStats.latencyMinUs = 0xFFFFFFFFu;
+}
+
+bool pushRaw(const MidiOut::Event& ev, uint32_t t_us) {
     uint16_t head = qHead;
     uint16_t tail = qTail; // snapshot
-    if (isFull(head, tail)) {
-        return false; // drop if full (non-blocking)
-    }
+    if (isFull(head, tail)) return false;
     qbuf[head] = ev;
+    qTime[head] = t_us;
+    // Release: the slot is complete before the consumer (possibly an ISR) sees the new head
+    __atomic_thread_fence(__ATOMIC_RELEASE);
     qHead = nextIndex(head);
+    const uint16_t used = (uint16_t)((qHead - tail) & (kQueueSize - 1));
+    if (used > sStats.noteHighWater) sStats.noteHighWater = used;
     return true;
 }
 
-void service(uint32_t budgetUs) {
-    // Fast early-out: if queue is empty, do nothing
-    {
-        uint16_t head = qHead;
-        uint16_t tail = qTail;
-        if (isEmpty(head, tail)) return;
+// Deferred NoteOffs back into the ring (producer side only), before any newer event
+void refillFromOverflow(uint32_t t_us) {
+    for (uint8_t ch = 0; ch < 16 && sOffOverflowCount; ch++) {
+        for (uint8_t w = 0; w < 4; w++) {
+            while (sOffOverflow[ch][w]) {
+                const uint8_t bit = (uint8_t)__builtin_ctz(sOffOverflow[ch][w]);
+                const MidiOut::Event off{MidiOut::Kind::NoteOff, (uint8_t)(ch + 1), (uint8_t)(w * 32 + bit), 0};
+                if (!pushRaw(off, t_us)) return;
+                sOffOverflow[ch][w] &= ~(1u << bit);
+                sOffOverflowCount--;
+            }
+        }
     }
-    const uint32_t start = micros();
-    bool didSend = false;
-    // Drain until time budget or empty
-    while (true) {
-        uint16_t head = qHead; // snapshot
-        uint16_t tail = qTail;
-        if (isEmpty(head, tail)) break;
-        const Event ev = qbuf[tail];
-        qTail = nextIndex(tail);
+}
 
-        sendEvent(ev);
-        didSend = true;
+// Ring behind the deferred NoteOffs; false if the event did not enter (NoteOff deferred,
+// anything else dropped)
+bool pushNote(const MidiOut::Event& ev, uint32_t t_us) {
+    if (sOffOverflowCount) refillFromOverflow(t_us);
+    if (!sOffOverflowCount && pushRaw(ev, t_us)) return true;
+    if (ev.kind == MidiOut::Kind::NoteOff) {
+        uint32_t& word = sOffOverflow[(ev.ch - 1) & 0x0F][(ev.d1 >> 5) & 3];
+        const uint32_t bit = 1u << (ev.d1 & 31);
+        if (!(word & bit)) { word |= bit; sOffOverflowCount++; }
+        sStats.noteOffDeferred++;
+    } else {
+        sStats.noteDropped++;
+    }
+    return false;
+}
+} // namespace
 
-        // If we've spent the budget, flush and return
-        if ((micros() - start) >= budgetUs) {
-            if (didSend) usbMIDI.send_now();
-            return;
-        }
+namespace MidiOut {
+
+void init() {
+    sContPending = 0;
+    memset(sOffOverflow, 0, sizeof(sOffOverflow));
+    sOffOverflowCount = 0;
+    sLastFlushFrame = 0xFFFFFFFFu;
+    resetStats();
+    if (kDrainIsr) sDrainEvent.attachSoftwareInterrupt(drainHandler);
+    if (kMidiDinEnabled) MidiDin::init();
+    setConstantLatency(kConstLatencyOffsetUs);
+}
+
+bool enqueue(const Event& ev, uint32_t t_us) {
+    // DIN has its own queue and acceptance policy: it takes every event, whatever the USB side
+    // does with it, so neither backend ever holds back the other
+    if (kMidiDinEnabled) MidiDin::enqueue(ev);
+    if (!isContinuous(ev.kind)) {
+        const bool ok = pushNote(ev, t_us);
+        requestDrain();
+        return ok;
     }
-    // Flush only if we actually pushed events this round
-    if (didSend) usbMIDI.send_now();
+    // The coalescing table is shared with the scheduler ISR in constant-latency mode
+    bool ok = true;
+    noInterrupts();
+    const uint16_t key = contKey(ev);
+    const int8_t hit = findPending(key);
+    if (hit >= 0) {
+        sCont[hit].ev = ev; // latest value wins
+        sStats.coalesced++;
+    } else if (sContPending == 0xFFFFFFFFu) {
+        sStats.contDropped++;
+        ok = false;
+    } else {
+        const uint8_t i = (uint8_t)__builtin_ctz(~sContPending);
+        sCont[i].key = key;
+        sCont[i].ev = ev;
+        sCont[i].t_us = t_us;
+        sContPending |= (1u << i);
+        const uint8_t pending = (uint8_t)__builtin_popcount(sContPending);
+        if (pending > sStats.contHighWater) sStats.contHighWater = pending;
+    }
+    interrupts();
+    if (ok) requestDrain();
+    return ok;
+}
+
+bool enqueueInOrder(const Event& ev, uint32_t t_us) {
+    if (kMidiDinEnabled) MidiDin::enqueueInOrder(ev);
+    const bool ok = pushNote(ev, t_us);
+    if (ok && isContinuous(ev.kind)) {
+        noInterrupts();
+        const int8_t stale = findPending(contKey(ev));
+        if (stale >= 0) sContPending &= ~(1u << stale);
+        interrupts();
+    }
+    requestDrain();
+    return ok;
+}
+
+bool sendSysEx(const uint8_t* data, uint16_t len) {
+    if (sSysexLen || len == 0 || len > kSysexMax) return false;
+    memcpy(sSysex, data, len);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    sSysexLen = len; // publish after the copy
+    requestDrain();
+    return true;
+}
+
+void service(uint32_t budgetUs) {
+    if (sOffOverflowCount) refillFromOverflow(micros());
+    if (sHoldUs) return; // constant-latency mode: the scheduler ISR writes
+    // Fast early-out: if all classes are empty, do nothing
+    if (isEmpty(qHead, qTail) && sContPending == 0 && sSysexLen == 0) return;
+    if (kDrainIsr) { requestDrain(); return; } // leftovers of a budget-limited drain
+    // One flush per microframe: events arriving in between accumulate and leave together.
+    // A microframe counter that stopped (no SOF) falls back to one drain per kFrameFallbackUs.
+    const uint32_t frame = currentMicroframe();
+    const uint32_t now = micros();
+    if (frame == sLastFlushFrame && now - sLastFlushUs < kFrameFallbackUs) return;
+    sLastFlushFrame = frame;
+    sLastFlushUs = now;
+    drain(now, 0, budgetUs, !usb_configuration);
+}
+
+void setConstantLatency(uint32_t offsetUs) {
+    sLatencyTimer.end();
+    sHoldUs = offsetUs;
+    if (offsetUs) {
+        sLatencyTimer.priority(255); // never ahead of USB or the scan-critical interrupts
+        sLatencyTimer.begin(latencyTick, kConstLatencyTickUs);
+    }
+}
+
+uint32_t constantLatency() { return sHoldUs; }
+
+void deferDrain() {
+    if (!kDrainIsr) return;
+    sDeferDepth = sDeferDepth + 1;
+}
+
+void resumeDrain() {
+    if (!kDrainIsr || sDeferDepth == 0) return;
+    sDeferDepth = sDeferDepth - 1;
+    if (sDeferDepth == 0 && sDrainPending) sDrainEvent.triggerEvent();
+}
+
+void takeStats(Stats& out) {
+    noInterrupts();
+    out = sStats;
+    resetStats();
+    interrupts();
+    if (out.latencyMinUs == 0xFFFFFFFFu) out.latencyMinUs = 0;
 }
 
 } // namespace MidiOut
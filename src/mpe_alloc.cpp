@@ -0,0 +1,81 @@
+#include "mpe_alloc.h"
+
+namespace {
+constexpr uint8_t kNil = 0xFF;
+
+struct List {
+    uint8_t head = kNil; // plus ancien
+    uint8_t tail = kNil; // plus récent
+};
+
+uint8_t sFirstCh = 2;
+uint8_t sCount = 0;
+uint8_t sPrev[MpeAlloc::kMaxChannels];
+uint8_t sNext[MpeAlloc::kMaxChannels];
+uint8_t sOwner[MpeAlloc::kMaxChannels]; // kNone = libre
+List sFree;
+List sBusy;
+
+void unlink(List& l, uint8_t i) {
+    if (sPrev[i] != kNil) sNext[sPrev[i]] = sNext[i]; else l.head = sNext[i];
+    if (sNext[i] != kNil) sPrev[sNext[i]] = sPrev[i]; else l.tail = sPrev[i];
+    sPrev[i] = sNext[i] = kNil;
+}
+
+void append(List& l, uint8_t i) {
+    sPrev[i] = l.tail;
+    sNext[i] = kNil;
+    if (l.tail != kNil) sNext[l.tail] = i; else l.head = i;
+    l.tail = i;
+}
+
+inline uint8_t slotOf(uint8_t ch) {
+    const uint8_t i = (uint8_t)(ch - sFirstCh);
+    return (ch >= sFirstCh && i < sCount) ? i : kNil;
+}
+} // namespace
+
+namespace MpeAlloc {
+
+void init(uint8_t firstCh, uint8_t count) {
+    sFirstCh = firstCh;
+    sCount = (count > kMaxChannels) ? kMaxChannels : count;
+    sFree = List{};
+    sBusy = List{};
+    for (uint8_t i = 0; i < sCount; i++) {
+        sOwner[i] = kNone;
+        append(sFree, i);
+    }
+}
+
+uint8_t allocate(uint8_t key, uint8_t& stolenKey) {
+    stolenKey = kNone;
+    uint8_t i = sFree.head;
+    if (i != kNil) {
+        unlink(sFree, i);
+    } else {
+        // Vol de voix: la note attribuée le plus anciennement
+        i = sBusy.head;
+        if (i == kNil) return sFirstCh; // aucun canal configuré
+        unlink(sBusy, i);
+        stolenKey = sOwner[i];
+    }
+    sOwner[i] = key;
+    append(sBusy, i);
+    return (uint8_t)(sFirstCh + i);
+}
+
+void release(uint8_t ch) {
+    const uint8_t i = slotOf(ch);
+    if (i == kNil || sOwner[i] == kNone) return;
+    unlink(sBusy, i);
+    sOwner[i] = kNone;
+    append(sFree, i);
+}
+
+uint8_t owner(uint8_t ch) {
+    const uint8_t i = slotOf(ch);
+    return (i == kNil) ? kNone : sOwner[i];
+}
+
+} // namespace MpeAlloc
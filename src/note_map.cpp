@@ -1,105 +1,142 @@
 #include "note_map.h"
+#include "eeprom_store.h"
+#include "velocity_curves.h"
 
 // Global transpose value (default: no transpose)
 int8_t gTranspose = 0;
 
+static constexpr LayoutDef kLayouts[(uint8_t)LayoutKind::Count] = {
+    {"janko",          48, 2, 1, 2},
+    {"wicki-hayden",   36, 2, 5, 0},
+    {"chromatic",      48, 1, 16, 0},
+    {"harmonic-table", 24, 4, 7, 0},
+};
+
+// Double buffer: the engine writes the inactive table then swaps the pointer
+static KeyOutputs sOutputTables[2][N_MUX][N_CH];
+static uint8_t sActiveIndex = 0;
+const KeyOutputs (* volatile gActiveOutputs)[N_CH] = sOutputTables[0];
+static LayoutKind sLayout = LayoutKind::Janko;
+static Zone sZones[kMaxZones];
+static uint8_t sZoneCount = 0;
+
+// EEPROM image of the layout settings
+struct StoredLayout {
+    uint8_t kind;
+    uint8_t zoneCount;
+    Zone zones[kMaxZones];
+} __attribute__((packed));
+
 static inline int8_t clampTranspose(int8_t s) {
     if (s < -24) return -24;
     if (s >  24) return  24;
     return s;
 }
 
-void noteMapSetTranspose(int8_t semitones) {
-    gTranspose = clampTranspose(semitones);
+static inline bool validZone(const Zone& z) {
+    return z.row0 <= z.row1 && z.row1 < kGridRows && z.col0 <= z.col1 && z.col1 < kGridCols &&
+           z.ch >= 1 && z.ch <= 16 && z.layerCh <= 16 &&
+           (z.curve == kZoneKeepCurve || z.curve < VelocityCurves::kCurveCount);
+}
+
+static inline void addOutput(KeyOutputs& ko, uint8_t ch, int16_t note) {
+    if (note < 0 || note > 127 || ko.count >= kMaxLayers) return;
+    ko.out[ko.count].ch = ch;
+    ko.out[ko.count].note = (uint8_t)note;
+    ko.count++;
 }
 
-/**
- * Note mapping table [mux][channel] -> MIDI note
- * Generated from kPhysicalLayout (defined in note_map.h) at compile time
- * Uses constexpr to compute all values during compilation (zero runtime cost)
- */
-const int8_t kNoteMap[8][16] = {
-    // MUX 0
-    {
-        generateNoteMap(0,0), generateNoteMap(0,1), generateNoteMap(0,2), generateNoteMap(0,3),
-        generateNoteMap(0,4), generateNoteMap(0,5), generateNoteMap(0,6), generateNoteMap(0,7),
-        generateNoteMap(0,8), generateNoteMap(0,9), generateNoteMap(0,10), generateNoteMap(0,11),
-        generateNoteMap(0,12), generateNoteMap(0,13), generateNoteMap(0,14), generateNoteMap(0,15)
-    },
-    // MUX 1
-    {
-        generateNoteMap(1,0), generateNoteMap(1,1), generateNoteMap(1,2), generateNoteMap(1,3),
-        generateNoteMap(1,4), generateNoteMap(1,5), generateNoteMap(1,6), generateNoteMap(1,7),
-        generateNoteMap(1,8), generateNoteMap(1,9), generateNoteMap(1,10), generateNoteMap(1,11),
-        generateNoteMap(1,12), generateNoteMap(1,13), generateNoteMap(1,14), generateNoteMap(1,15)
-    },
-    // MUX 2
-    {
-        generateNoteMap(2,0), generateNoteMap(2,1), generateNoteMap(2,2), generateNoteMap(2,3),
-        generateNoteMap(2,4), generateNoteMap(2,5), generateNoteMap(2,6), generateNoteMap(2,7),
-        generateNoteMap(2,8), generateNoteMap(2,9), generateNoteMap(2,10), generateNoteMap(2,11),
-        generateNoteMap(2,12), generateNoteMap(2,13), generateNoteMap(2,14), generateNoteMap(2,15)
-    },
-    // MUX 3
-    {
-        generateNoteMap(3,0), generateNoteMap(3,1), generateNoteMap(3,2), generateNoteMap(3,3),
-        generateNoteMap(3,4), generateNoteMap(3,5), generateNoteMap(3,6), generateNoteMap(3,7),
-        generateNoteMap(3,8), generateNoteMap(3,9), generateNoteMap(3,10), generateNoteMap(3,11),
-        generateNoteMap(3,12), generateNoteMap(3,13), generateNoteMap(3,14), generateNoteMap(3,15)
-    },
-    // MUX 4
-    {
-        generateNoteMap(4,0), generateNoteMap(4,1), generateNoteMap(4,2), generateNoteMap(4,3),
-        generateNoteMap(4,4), generateNoteMap(4,5), generateNoteMap(4,6), generateNoteMap(4,7),
-        generateNoteMap(4,8), generateNoteMap(4,9), generateNoteMap(4,10), generateNoteMap(4,11),
-        generateNoteMap(4,12), generateNoteMap(4,13), generateNoteMap(4,14), generateNoteMap(4,15)
-    },
-    // MUX 5
-    {
-        generateNoteMap(5,0), generateNoteMap(5,1), generateNoteMap(5,2), generateNoteMap(5,3),
-        generateNoteMap(5,4), generateNoteMap(5,5), generateNoteMap(5,6), generateNoteMap(5,7),
-        generateNoteMap(5,8), generateNoteMap(5,9), generateNoteMap(5,10), generateNoteMap(5,11),
-        generateNoteMap(5,12), generateNoteMap(5,13), generateNoteMap(5,14), generateNoteMap(5,15)
-    },
-    // MUX 6
-    {
-        generateNoteMap(6,0), generateNoteMap(6,1), generateNoteMap(6,2), generateNoteMap(6,3),
-        generateNoteMap(6,4), generateNoteMap(6,5), generateNoteMap(6,6), generateNoteMap(6,7),
-        generateNoteMap(6,8), generateNoteMap(6,9), generateNoteMap(6,10), generateNoteMap(6,11),
-        generateNoteMap(6,12), generateNoteMap(6,13), generateNoteMap(6,14), generateNoteMap(6,15)
-    },
-    // MUX 7
-    {
-        generateNoteMap(7,0), generateNoteMap(7,1), generateNoteMap(7,2), generateNoteMap(7,3),
-        generateNoteMap(7,4), generateNoteMap(7,5), generateNoteMap(7,6), generateNoteMap(7,7),
-        generateNoteMap(7,8), generateNoteMap(7,9), generateNoteMap(7,10), generateNoteMap(7,11),
-        generateNoteMap(7,12), generateNoteMap(7,13), generateNoteMap(7,14), generateNoteMap(7,15)
+// Generate the flat table for (layout, zones, transpose) into the inactive buffer and publish it
+static void publishLayout() {
+    const LayoutDef& def = kLayouts[(uint8_t)sLayout];
+    const uint8_t next = sActiveIndex ^ 1;
+    for (uint8_t row = 0; row < kGridRows; row++) {
+        const uint8_t r = def.rowPeriod ? (uint8_t)(row % def.rowPeriod) : row;
+        for (uint8_t col = 0; col < kGridCols; col++) {
+            const int16_t base = (int16_t)def.base + (int16_t)col * def.colStep + (int16_t)r * def.rowStep + gTranspose;
+            KeyOutputs ko{};
+            ko.curve = kZoneKeepCurve;
+            const Zone* zone = nullptr;
+            for (uint8_t z = 0; z < sZoneCount; z++) {
+                const Zone& zz = sZones[z];
+                if (row >= zz.row0 && row <= zz.row1 && col >= zz.col0 && col <= zz.col1) { zone = &zz; break; }
+            }
+            if (zone) {
+                const int16_t note = base + zone->transpose;
+                addOutput(ko, zone->ch, note);
+                if (zone->layerCh) addOutput(ko, zone->layerCh, note + zone->layerTranspose);
+                ko.curve = zone->curve; // derived only: the persisted per-key curve stays untouched
+            } else {
+                addOutput(ko, kMidiChannel, base);
+            }
+            sOutputTables[next][row][col] = ko;
+        }
     }
-};
+    gActiveOutputs = sOutputTables[next]; // single aligned store: readers see old or new table
+    sActiveIndex = next;
+}
 
-int8_t effectiveNote(uint8_t mux, uint8_t channel) {
-    // Bounds checking
-    if (mux >= N_MUX || channel >= N_CH) {
-        return DISABLED;
+void noteMapInit() {
+    StoredLayout st;
+    if (EepromStore::loadSection(EepromStore::Section::Layout, &st, sizeof(st)) == sizeof(st)) {
+        if (st.kind < (uint8_t)LayoutKind::Count) sLayout = (LayoutKind)st.kind;
+        sZoneCount = 0;
+        for (uint8_t z = 0; z < st.zoneCount && z < kMaxZones; z++) {
+            if (validZone(st.zones[z])) sZones[sZoneCount++] = st.zones[z];
+        }
     }
-    
-    // Get mapped note
-    int8_t mappedNote = kNoteMap[mux][channel];
-    
-    // Check if key is disabled
-    if (mappedNote == DISABLED) {
-        return DISABLED;
+    publishLayout();
+}
+
+void noteMapSetTranspose(int8_t semitones) {
+    int8_t t = clampTranspose(semitones);
+    if (t == gTranspose) return;
+    gTranspose = t;
+    publishLayout();
+}
+
+bool noteMapSetLayout(LayoutKind kind) {
+    if ((uint8_t)kind >= (uint8_t)LayoutKind::Count) return false;
+    sLayout = kind;
+    publishLayout();
+    return true;
+}
+
+LayoutKind noteMapLayout() { return sLayout; }
+
+const LayoutDef& noteMapLayoutDef(LayoutKind kind) {
+    return kLayouts[((uint8_t)kind < (uint8_t)LayoutKind::Count) ? (uint8_t)kind : 0];
+}
+
+bool noteMapSetZones(const Zone* zones, uint8_t n) {
+    if (n > kMaxZones) return false;
+    for (uint8_t z = 0; z < n; z++) {
+        if (!validZone(zones[z])) return false;
     }
-    // Apply current global transpose (updated by IoState via noteMapSetTranspose)
-    int16_t transposed = (int16_t)mappedNote + (int16_t)gTranspose;
-    if (transposed < 0 || transposed > 127) {
-        return DISABLED;
+    for (uint8_t z = 0; z < n; z++) sZones[z] = zones[z];
+    sZoneCount = n;
+    publishLayout();
+    return true;
+}
+
+uint8_t noteMapZones(Zone* out) {
+    if (out) {
+        for (uint8_t z = 0; z < sZoneCount; z++) out[z] = sZones[z];
     }
-    return (int8_t)transposed;
+    return sZoneCount;
+}
+
+bool noteMapSave() {
+    StoredLayout st;
+    memset(&st, 0, sizeof(st));
+    st.kind = (uint8_t)sLayout;
+    st.zoneCount = sZoneCount;
+    for (uint8_t z = 0; z < sZoneCount; z++) st.zones[z] = sZones[z];
+    return EepromStore::saveSection(EepromStore::Section::Layout, &st, sizeof(st));
 }
 
 void printNoteMap() {
     // Mapping print removed (no Serial in performance build)
 }
 
-// Pin polling moved to IoState
\ No newline at end of file
+// Pin polling moved to IoState
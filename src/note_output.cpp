@@ -0,0 +1,113 @@
+#include "note_output.h"
+#include "config.h"
+#include "note_map.h"
+#include "midi_out.h"
+#include "mpe_alloc.h"
+
+namespace {
+// Outputs effectively sent per key (resolved at Press, reused for the Release)
+KeyOutputs sSent[kTotalKeys];
+// Nombre de touches tenant chaque hauteur, par canal MIDI (index canal 0..15)
+uint8_t sRefCount[16][128];
+
+enum class RetriggerPolicy : uint8_t { Ignore = 0, Retrigger = 1 };
+constexpr RetriggerPolicy kRetrigger = static_cast<RetriggerPolicy>(NOTE_RETRIGGER_POLICY);
+
+// t_us = detection time (constant-latency scheduling)
+void pitchOn(uint8_t ch, uint8_t note, uint8_t velocity, uint32_t t_us) {
+    uint8_t& ref = sRefCount[ch - 1][note];
+    if (ref == 0) {
+        MidiOut::enqueue(MidiOut::Event{MidiOut::Kind::NoteOn, ch, note, velocity}, t_us);
+    } else if (kRetrigger == RetriggerPolicy::Retrigger) {
+        MidiOut::enqueue(MidiOut::Event{MidiOut::Kind::NoteOff, ch, note, 0}, t_us);
+        MidiOut::enqueue(MidiOut::Event{MidiOut::Kind::NoteOn, ch, note, velocity}, t_us);
+    }
+    if (ref < 255) ref++;
+}
+
+void pitchOff(uint8_t ch, uint8_t note, uint32_t t_us) {
+    uint8_t& ref = sRefCount[ch - 1][note];
+    if (ref > 1) { ref--; return; } // still held by another key
+    MidiOut::enqueue(MidiOut::Event{MidiOut::Kind::NoteOff, ch, note, 0}, t_us);
+    ref = 0;
+}
+
+// MPE: zone basse annoncée par le MPE Configuration Message (RPN 6 sur le canal maître)
+void sendMpeConfiguration() {
+    MidiOut::enqueueInOrder(MidiOut::Event{MidiOut::Kind::CC, kMpeMasterChannel, 101, 0});
+    MidiOut::enqueueInOrder(MidiOut::Event{MidiOut::Kind::CC, kMpeMasterChannel, 100, 6});
+    MidiOut::enqueueInOrder(MidiOut::Event{MidiOut::Kind::CC, kMpeMasterChannel, 6, kMpeMemberCount});
+}
+
+// MPE Press: un canal membre par note; état initial (timbre, pression) avant le NoteOn
+bool mpePress(const KeyEvents::KeyEvent& ev, const KeyOutputs& ko) {
+    if (ko.count == 0) return true;
+    // NoteOff volé + CC74 + pression + NoteOn, ordonnés dans la file des notes
+    uint8_t stolen;
+    const uint8_t ch = MpeAlloc::allocate(ev.key, stolen);
+    if (stolen != MpeAlloc::kNone) {
+        // La note volée est coupée ici; son Release ne trouvera plus rien à envoyer
+        KeyOutputs& victim = sSent[stolen];
+        if (victim.count) pitchOff(victim.out[0].ch, victim.out[0].note, ev.t_us);
+        victim.count = 0;
+    }
+    const uint8_t note = ko.out[0].note;
+    MidiOut::enqueueInOrder(MidiOut::Event{MidiOut::Kind::CC, ch, kMpeTimbreCC, (uint8_t)(ev.value & 0x7F)}, ev.t_us);
+    MidiOut::enqueueInOrder(MidiOut::Event{MidiOut::Kind::ChannelPressure, ch, 0, 0}, ev.t_us);
+    pitchOn(ch, note, ev.velocity, ev.t_us);
+    KeyOutputs& sent = sSent[ev.key];
+    sent.count = 1;
+    sent.out[0] = NoteOut{ch, note};
+    return true;
+}
+} // namespace
+
+namespace NoteOutput {
+
+void init() {
+    memset(sSent, 0, sizeof(sSent));
+    memset(sRefCount, 0, sizeof(sRefCount));
+    if (kMpeMode) {
+        MpeAlloc::init(kMpeMasterChannel + 1, kMpeMemberCount);
+        sendMpeConfiguration();
+    }
+    KeyEvents::subscribe(onKeyEvent);
+}
+
+bool onKeyEvent(const KeyEvents::KeyEvent& ev) {
+    if (ev.key >= kTotalKeys) return true;
+    switch (ev.kind) {
+        case KeyEvents::Kind::Press: {
+            // Fixed walk over the key's precomputed outputs (zones/layers resolved by the layout engine)
+            const KeyOutputs& ko = keyOutputs(KeyEvents::keyMux(ev.key), KeyEvents::keyChannel(ev.key));
+            if (kMpeMode) return mpePress(ev, ko);
+            for (uint8_t i = 0; i < ko.count; i++) pitchOn(ko.out[i].ch, ko.out[i].note, ev.velocity, ev.t_us);
+            sSent[ev.key] = ko;
+            return true;
+        }
+        case KeyEvents::Kind::Release: {
+            KeyOutputs& sent = sSent[ev.key];
+            for (uint8_t i = 0; i < sent.count; i++) {
+                pitchOff(sent.out[i].ch, sent.out[i].note, ev.t_us);
+                if (kMpeMode) MpeAlloc::release(sent.out[i].ch); // retour au canal propriétaire
+            }
+            sent.count = 0;
+            return true;
+        }
+        case KeyEvents::Kind::Pressure: {
+            // Donnée continue: coalescée par MidiOut (dernière valeur par canal), jamais bloquante
+            const KeyOutputs& sent = sSent[ev.key];
+            if (!kMpeMode || sent.count == 0) return true;
+            MidiOut::enqueue(MidiOut::Event{MidiOut::Kind::ChannelPressure, sent.out[0].ch, ev.value, 0}, ev.t_us);
+            return true;
+        }
+    }
+    return true;
+}
+
+uint8_t heldCount(uint8_t ch, uint8_t note) {
+    if (ch < 1 || ch > 16 || note > 127) return 0;
+    return sRefCount[ch - 1][note];
+}
+
+} // namespace NoteOutput
@@ -0,0 +1,283 @@
+#include "sysex_config.h"
+#include "config.h"
+#include "calibration.h"
+#include "velocity_engine.h"
+#include "velocity_calc.h"
+#include "velocity_curves.h"
+#include "travel_map.h"
+#include "note_map.h"
+#include "eeprom_store.h"
+#include "midi_out.h"
+#include <usb_midi.h>
+
+namespace {
+using SysexConfig::Status;
+
+// Reception: bytes between F0 and F7 (exclusive), one complete message waiting at most
+constexpr uint16_t kRxMax = 80;   // largest request: SetThresholds = 3 + 64 bytes
+uint8_t sRx[kRxMax];
+uint16_t sRxLen = 0;
+bool sRxActive = false;    // inside F0 ... F7
+bool sRxOverflow = false;
+bool sRxReady = false;     // complete message waiting for service()
+uint32_t sRxDropped = 0;
+
+// Reply being sent (retried until the MidiOut SysEx slot accepts it)
+uint8_t sTx[MidiOut::kSysexMax];
+uint16_t sTxLen = 0;
+
+// Chunked dumps: next row to send, 0xFF = idle
+uint8_t sDumpThresholdsMux = 0xFF;
+uint8_t sDumpCurvesMux = 0xFF;
+
+constexpr uint8_t kAllRows = 0x7F;
+constexpr uint8_t kReplyAck = 0x7E;
+
+inline void put14(uint8_t* p, uint16_t v) { p[0] = (uint8_t)((v >> 7) & 0x7F); p[1] = (uint8_t)(v & 0x7F); }
+inline uint16_t get14(const uint8_t* p) { return (uint16_t)(((uint16_t)p[0] << 7) | p[1]); }
+inline uint8_t putSigned(int8_t v) { return (uint8_t)((v + 64) & 0x7F); }
+inline int8_t getSigned(uint8_t b) { return (int8_t)((int)b - 64); }
+
+// Starts a reply frame; returns the write cursor after the header
+uint8_t* beginReply(uint8_t cmd) {
+    sTx[0] = 0xF0; sTx[1] = SysexConfig::kManufacturer; sTx[2] = SysexConfig::kDeviceId; sTx[3] = cmd;
+    return sTx + 4;
+}
+void endReply(uint8_t* end) {
+    *end++ = 0xF7;
+    sTxLen = (uint16_t)(end - sTx);
+}
+void ack(uint8_t cmd, Status st) {
+    uint8_t* p = beginReply(kReplyAck);
+    *p++ = cmd;
+    *p++ = (uint8_t)st;
+    endReply(p);
+}
+
+void replyThresholds(uint8_t mux) {
+    uint8_t* p = beginReply(0x42);
+    *p++ = mux;
+    for (uint8_t c = 0; c < N_CH; c++) {
+        put14(p, gThLow[mux][c]);  p += 2;
+        put14(p, gThHigh[mux][c]); p += 2;
+    }
+    endReply(p);
+}
+
+void replyKeyCurves(uint8_t mux) {
+    uint8_t* p = beginReply(0x46);
+    *p++ = mux;
+    for (uint8_t c = 0; c < N_CH; c++) *p++ = VelocityCurves::keyCurve(mux, c);
+    endReply(p);
+}
+
+Status setThresholds(const uint8_t* d, uint16_t n) {
+    if (n != 1 + N_CH * 4) return Status::BadLength;
+    const uint8_t mux = d[0];
+    if (mux >= N_MUX) return Status::BadValue;
+    // Validate the whole row first: a rejected message changes nothing
+    for (uint8_t c = 0; c < N_CH; c++) {
+        const uint16_t lo = get14(d + 1 + c * 4), hi = get14(d + 3 + c * 4);
+        if (lo > 1023 || hi > 1023 || abs((int)hi - (int)lo) < (int)Calib::kMinSwingCounts) return Status::BadValue;
+    }
+    for (uint8_t c = 0; c < N_CH; c++) {
+        const int dLow = (int)get14(d + 1 + c * 4) - (int)gThLow[mux][c];
+        const int dHigh = (int)get14(d + 3 + c * 4) - (int)gThHigh[mux][c];
+        gThLow[mux][c]  = get14(d + 1 + c * 4);
+        gThHigh[mux][c] = get14(d + 3 + c * 4);
+        calibUpdateRelease(mux, c);
+        // Measured rest/peak move with the thresholds (no inversion of margins)
+        TravelMap::shift(mux, c, dLow, dHigh);
+        VelocityEngine::refreshQuietBand(mux, c);
+    }
+    return Status::Ok;
+}
+
+Status setCurve(const uint8_t* d, uint16_t n) {
+    if (n < 2) return Status::BadLength;
+    VelocityCurves::CurvePoints pts;
+    pts.n = d[1];
+    if (pts.n < 2 || pts.n > VelocityCurves::kMaxPoints) return Status::BadValue;
+    if (n != 2u + pts.n * 3u) return Status::BadLength;
+    for (uint8_t i = 0; i < pts.n; i++) {
+        const uint16_t x = get14(d + 2 + i * 3);
+        if (x > 255) return Status::BadValue;
+        pts.x[i] = (uint8_t)x;
+        pts.y[i] = d[4 + i * 3];
+    }
+    return VelocityCurves::setCurvePoints(d[0], pts) ? Status::Ok : Status::BadValue;
+}
+
+Status setKeyCurves(const uint8_t* d, uint16_t n) {
+    if (n != 1 + N_CH) return Status::BadLength;
+    if (d[0] >= N_MUX) return Status::BadValue;
+    for (uint8_t c = 0; c < N_CH; c++) {
+        if (d[1 + c] >= VelocityCurves::kCurveCount) return Status::BadValue;
+    }
+    for (uint8_t c = 0; c < N_CH; c++) VelocityCurves::setKeyCurve(d[0], c, d[1 + c]);
+    return Status::Ok;
+}
+
+void replyLayout() {
+    Zone zones[kMaxZones];
+    const uint8_t nz = noteMapZones(zones);
+    uint8_t* p = beginReply(0x48);
+    *p++ = (uint8_t)noteMapLayout();
+    *p++ = putSigned(gTranspose);
+    *p++ = nz;
+    for (uint8_t z = 0; z < nz; z++) {
+        const Zone& zz = zones[z];
+        *p++ = zz.row0; *p++ = zz.col0; *p++ = zz.row1; *p++ = zz.col1;
+        *p++ = zz.ch;
+        *p++ = putSigned(zz.transpose);
+        *p++ = (zz.curve == kZoneKeepCurve) ? 0x7F : zz.curve;
+        *p++ = zz.layerCh;
+        *p++ = putSigned(zz.layerTranspose);
+    }
+    endReply(p);
+}
+
+Status setLayout(const uint8_t* d, uint16_t n) {
+    if (n < 2) return Status::BadLength;
+    const uint8_t nz = d[1];
+    if (nz > kMaxZones) return Status::BadValue;
+    if (n != 2u + nz * 9u) return Status::BadLength;
+    if (d[0] >= (uint8_t)LayoutKind::Count) return Status::BadValue;
+    Zone zones[kMaxZones];
+    for (uint8_t z = 0; z < nz; z++) {
+        const uint8_t* q = d + 2 + z * 9;
+        zones[z] = Zone{q[0], q[1], q[2], q[3], q[4], getSigned(q[5]),
+                        (q[6] == 0x7F) ? kZoneKeepCurve : q[6], q[7], getSigned(q[8])};
+        if (zones[z].curve != kZoneKeepCurve && zones[z].curve >= VelocityCurves::kCurveCount) return Status::BadValue;
+    }
+    if (!noteMapSetZones(zones, nz)) return Status::BadValue;
+    noteMapSetLayout((LayoutKind)d[0]);
+    return Status::Ok;
+}
+
+Status setScan(const uint8_t* d, uint16_t n) {
+    if (n != 6) return Status::BadLength;
+    const uint16_t settle = get14(d), cycles = get14(d + 2), gammaK = get14(d + 4);
+    if (settle > 50 || gammaK < 50 || gammaK > 2000) return Status::BadValue;
+    gScanSettleMicros = settle;
+    gScanPairDelayCycles = cycles;
+    gVelocityGamma = (float)gammaK / 1000.0f;
+    VelocityCurves::rebuildGamma();
+    return Status::Ok;
+}
+
+void execute(const uint8_t* msg, uint16_t len) {
+    if (len < 3 || msg[0] != SysexConfig::kManufacturer || msg[1] != SysexConfig::kDeviceId) return; // not ours
+    const uint8_t cmd = msg[2];
+    const uint8_t* d = msg + 3;
+    const uint16_t n = (uint16_t)(len - 3);
+    switch (cmd) {
+        case 0x01: {
+            uint8_t* p = beginReply(0x41);
+            *p++ = SysexConfig::kProtocol; *p++ = N_MUX; *p++ = N_CH;
+            endReply(p);
+            break; }
+        case 0x02:
+            if (n != 1 || (d[0] >= N_MUX && d[0] != kAllRows)) { ack(cmd, Status::BadValue); break; }
+            sDumpThresholdsMux = (d[0] == kAllRows) ? 0 : d[0] | 0x80; // 0x80: single row
+            break;
+        case 0x03: ack(cmd, setThresholds(d, n)); break;
+        case 0x04: {
+            VelocityCurves::CurvePoints pts;
+            if (n != 1 || !VelocityCurves::getCurvePoints(d[0], pts)) { ack(cmd, Status::BadValue); break; }
+            uint8_t* p = beginReply(0x44);
+            *p++ = d[0]; *p++ = pts.n;
+            for (uint8_t i = 0; i < pts.n; i++) { put14(p, pts.x[i]); p += 2; *p++ = pts.y[i] & 0x7F; }
+            endReply(p);
+            break; }
+        case 0x05: ack(cmd, setCurve(d, n)); break;
+        case 0x06:
+            if (n != 1 || (d[0] >= N_MUX && d[0] != kAllRows)) { ack(cmd, Status::BadValue); break; }
+            sDumpCurvesMux = (d[0] == kAllRows) ? 0 : d[0] | 0x80;
+            break;
+        case 0x07: ack(cmd, setKeyCurves(d, n)); break;
+        case 0x08: replyLayout(); break;
+        case 0x09: ack(cmd, setLayout(d, n)); break;
+        case 0x0A: {
+            uint8_t* p = beginReply(0x4A);
+            put14(p, (uint16_t)gScanSettleMicros); p += 2;
+            put14(p, (uint16_t)(gScanPairDelayCycles > 0x3FFF ? 0x3FFF : gScanPairDelayCycles)); p += 2;
+            put14(p, (uint16_t)(gVelocityGamma * 1000.0f + 0.5f)); p += 2;
+            endReply(p);
+            break; }
+        case 0x0B: ack(cmd, setScan(d, n)); break;
+        case 0x0C: {
+            // Snapshots; the background writer commits them (saveBusy() until done)
+            bool ok = calibrationSaveToEeprom();
+            ok = VelocityCurves::save() && ok;
+            ok = noteMapSave() && ok;
+            ack(cmd, ok ? Status::Ok : Status::Error);
+            break; }
+        default: ack(cmd, Status::Unknown); break;
+    }
+}
+
+// Next row of a chunked dump (one message per call); state: row | 0x80 = last row to send
+bool nextDumpChunk(uint8_t& state, void (*reply)(uint8_t)) {
+    if (state == 0xFF) return false;
+    const uint8_t mux = state & 0x7F;
+    reply(mux);
+    state = ((state & 0x80) || mux + 1 >= N_MUX) ? 0xFF : (uint8_t)(mux + 1);
+    return true;
+}
+
+void onUsbSysEx(const uint8_t* data, uint16_t length, bool /*complete*/) {
+    SysexConfig::feed(data, length);
+}
+} // namespace
+
+namespace SysexConfig {
+
+void init() {
+    usbMIDI.setHandleSystemExclusive(onUsbSysEx);
+}
+
+void feed(const uint8_t* data, uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+        const uint8_t b = data[i];
+        if (b == 0xF0) {
+            // While a complete message waits for service(), the new one is discarded
+            sRxActive = true;
+            sRxOverflow = sRxReady;
+            if (!sRxReady) sRxLen = 0;
+        } else if (b == 0xF7) {
+            if (sRxActive) {
+                if (sRxOverflow) sRxDropped++;
+                else sRxReady = true;
+            }
+            sRxActive = false;
+        } else if (sRxActive) {
+            if (b & 0x80) { sRxActive = false; continue; } // stray status byte: abort frame
+            if (sRxOverflow) continue;
+            if (sRxLen >= kRxMax) { sRxOverflow = true; continue; }
+            sRx[sRxLen++] = b;
+        }
+    }
+}
+
+void service() {
+    // Bounded USB read: a few packets per loop iteration (non-SysEx input is ignored). Nothing
+    // is read while a complete message waits: the next one stays in the USB buffer, not dropped.
+    for (uint8_t i = 0; i < 4 && !sRxReady && usbMIDI.read(); i++) {}
+
+    // Pending reply first: nothing new is produced until the slot has taken it
+    if (sTxLen) {
+        if (!MidiOut::sendSysEx(sTx, sTxLen)) return;
+        sTxLen = 0;
+    }
+    if (sRxReady) {
+        execute(sRx, sRxLen);
+        sRxLen = 0;
+        sRxReady = false;
+        return;
+    }
+    if (nextDumpChunk(sDumpThresholdsMux, replyThresholds)) return;
+    nextDumpChunk(sDumpCurvesMux, replyKeyCurves);
+}
+
+} // namespace SysexConfig
@@ -0,0 +1,176 @@
+#include "temp_comp.h"
+#include "calibration.h"
+#include "key_state.h"
+#include "velocity_engine.h"
+#include "baseline_tracker.h"
+#include "travel_map.h"
+
+namespace {
+// Incremental least squares y = a + b*t, t relative to the boot temperature
+struct Fit {
+    float n, st, sy, stt, sty;
+    void add(float t, float y) {
+        if (n >= (float)kTempMaxObs) { n *= 0.5f; st *= 0.5f; sy *= 0.5f; stt *= 0.5f; sty *= 0.5f; }
+        n += 1.0f; st += t; sy += y; stt += t * t; sty += t * y;
+    }
+    // Slope once the temperature spread is large enough, 0 otherwise
+    float slope() const {
+        if (n < 8.0f) return 0.0f;
+        const float mt = st / n;
+        const float var = stt / n - mt * mt;
+        if (var < kTempMinSpanC * kTempMinSpanC) return 0.0f;
+        const float b = (sty / n - mt * (sy / n)) / var;
+        return (b > kTempMaxSlope || b < -kTempMaxSlope) ? 0.0f : b;
+    }
+};
+
+struct KeyTemp {
+    Fit rest;
+    Fit swing;
+    uint16_t lastHigh;  // High after our own last change (a different value = learned from playing)
+    float accRest;      // correction not yet applied (counts)
+    float accSwing;
+};
+KeyTemp sKey[N_MUX][N_CH];
+float sTempC = 0.0f;
+float sRefC = 0.0f;         // boot temperature (regression origin)
+float sAppliedC = 0.0f;     // temperature of the last apply pass
+bool  sHaveTemp = false;
+uint32_t sLastSampleMs = 0, sLastLearnMs = 0, sLastApplyMs = 0;
+#if DEBUG_TEMP_LOG
+uint32_t sLastLogMs = 0;
+bool sLogHeader = false;
+#endif
+
+inline float clampAcc(float a) { return (a > 16.0f) ? 16.0f : ((a < -16.0f) ? -16.0f : a); }
+
+inline int takeStep(float& acc) {
+    int step = (int)acc; // toward zero: only whole counts
+    if (step > (int)kTempMaxStepCounts) step = (int)kTempMaxStepCounts;
+    if (step < -(int)kTempMaxStepCounts) step = -(int)kTempMaxStepCounts;
+    acc -= (float)step;
+    return step;
+}
+
+void learn() {
+    const float t = sTempC - sRefC;
+    for (uint8_t m = 0; m < N_MUX; m++) {
+        for (uint8_t c = 0; c < N_CH; c++) {
+            KeyTemp& k = sKey[m][c];
+            const uint16_t rest = BaselineTracker::restEstimate(m, c);
+            if (rest == 0) continue; // not anchored yet (or excluded / never idle)
+            k.rest.add(t, (float)rest);
+            const uint16_t high = gThHigh[m][c];
+            if (high != k.lastHigh) {
+                // High moved with playing since our last change: one swing sample
+                k.swing.add(t, (float)abs((int)high - (int)rest));
+                k.lastHigh = high;
+            }
+        }
+    }
+}
+
+void apply() {
+    const float dT = sTempC - sAppliedC;
+    sAppliedC = sTempC;
+    const bool canWrite = calibrationUxIdle();
+    for (uint8_t m = 0; m < N_MUX; m++) {
+        for (uint8_t c = 0; c < N_CH; c++) {
+            KeyTemp& k = sKey[m][c];
+            k.accRest = clampAcc(k.accRest + k.rest.slope() * dT);
+            k.accSwing = clampAcc(k.accSwing + k.swing.slope() * dT);
+            // Only between strokes: a threshold moving under a key in flight skews its timing
+            if (!canWrite || g_keys[m][c].state != KeyState::IDLE) continue;
+            const int dRest = takeStep(k.accRest);
+            const int dSwing = takeStep(k.accSwing);
+            if (dRest == 0 && dSwing == 0) continue;
+            const int low = (int)gThLow[m][c], high = (int)gThHigh[m][c];
+            const int s = (high >= low) ? +1 : -1;
+            // With baseline tracking, Low and the travel map rest follow the measured rest
+            // (BaselineTracker): shifting them here too would be undone by its EMA. Only the
+            // High side (rest prediction + swing) and the travel map peak swing are ours.
+            const int newLow = kBaselineTracking ? low : low + dRest;
+            const int newHigh = high + dRest + s * dSwing;
+            if (newLow < 0 || newLow > 1023 || newHigh < 0 || newHigh > 1023 ||
+                abs(newHigh - newLow) < (int)Calib::kMinSwingCounts) continue;
+            gThLow[m][c] = (uint16_t)newLow;
+            gThHigh[m][c] = (uint16_t)newHigh;
+            k.lastHigh = (uint16_t)newHigh;
+            calibUpdateRelease(m, c);
+            if (kBaselineTracking) {
+                TravelMap::shift(m, c, 0, s * dSwing);
+            } else {
+                TravelMap::shift(m, c, dRest, dRest + s * dSwing);
+                BaselineTracker::followShift(m, c);
+            }
+            VelocityEngine::refreshQuietBand(m, c);
+        }
+    }
+}
+
+#if DEBUG_TEMP_LOG
+void logCsv(uint32_t nowMs) {
+    if (!sLogHeader) {
+        Serial.println("temp_log,ms,tempC,mux,ch,rest,low,high,restSlope,swingSlope");
+        sLogHeader = true;
+    }
+    for (uint8_t m = 0; m < N_MUX; m++) {
+        for (uint8_t c = 0; c < N_CH; c++) {
+            Serial.printf("temp_log,%lu,%.2f,%u,%u,%u,%u,%u,%.3f,%.3f\n", (unsigned long)nowMs, (double)sTempC,
+                          m, c, BaselineTracker::restEstimate(m, c), gThLow[m][c], gThHigh[m][c],
+                          (double)sKey[m][c].rest.slope(), (double)sKey[m][c].swing.slope());
+        }
+    }
+}
+#endif
+} // namespace
+
+namespace TempComp {
+
+void init() {
+    for (uint8_t m = 0; m < N_MUX; m++) {
+        for (uint8_t c = 0; c < N_CH; c++) {
+            sKey[m][c] = KeyTemp{};
+            sKey[m][c].lastHigh = gThHigh[m][c];
+        }
+    }
+    sHaveTemp = false;
+    sLastSampleMs = sLastLearnMs = sLastApplyMs = millis();
+}
+
+void service(uint32_t nowMs) {
+    if (!kTempCompensation && !DEBUG_TEMP_LOG) return;
+    if (nowMs - sLastSampleMs >= kTempSampleMs || !sHaveTemp) {
+        sLastSampleMs = nowMs;
+        const float t = tempmonGetTemp();
+        if (!sHaveTemp) {
+            sTempC = sRefC = sAppliedC = t;
+            sHaveTemp = true;
+        } else {
+            sTempC += (t - sTempC) / (float)(1u << kTempFilterShift);
+        }
+        return; // one task per call: the loop stays short
+    }
+    if (nowMs - sLastLearnMs >= kTempLearnMs) {
+        sLastLearnMs = nowMs;
+        learn();
+        return;
+    }
+    if (kTempCompensation && nowMs - sLastApplyMs >= kTempApplyMs) {
+        sLastApplyMs = nowMs;
+        apply();
+        return;
+    }
+#if DEBUG_TEMP_LOG
+    if (nowMs - sLastLogMs >= DEBUG_TEMP_LOG_INTERVAL_MS) {
+        sLastLogMs = nowMs;
+        logCsv(nowMs);
+    }
+#endif
+}
+
+float temperatureC() { return sTempC; }
+float restSlope(uint8_t mux, uint8_t ch) { return sKey[mux][ch].rest.slope(); }
+float swingSlope(uint8_t mux, uint8_t ch) { return sKey[mux][ch].swing.slope(); }
+
+} // namespace TempComp
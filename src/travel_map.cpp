@@ -0,0 +1,126 @@
+#include "travel_map.h"
+#include "calibration.h"
+
+namespace TravelMap {
+uint16_t gTravelRest[N_MUX][N_CH];  // ADC au repos (course 0)
+uint16_t gTravelPeak[N_MUX][N_CH];  // ADC en fond de course
+}
+
+namespace {
+struct KeyTravel {
+    uint16_t rest;                              // copies locales de gTravelRest/gTravelPeak
+    uint16_t peak;                              // (peak != rest garanti)
+    uint8_t  knot[TravelMap::kSegments + 1];    // course en 1/255 de kKeyTravelUm
+};
+KeyTravel sTravel[N_MUX][N_CH];
+
+inline int clampAdc(int v) { return (v < 0) ? 0 : ((v > 1023) ? 1023 : v); }
+
+// Distance relative capteur-aimant pour une lecture v (à une constante près): |v - vQ|^(-1/n)
+inline float relDistance(float v) {
+    float b = fabsf(v - (float)TravelMap::kHallQuiescent);
+    return powf(b, -1.0f / TravelMap::kFieldExponent);
+}
+
+void buildLinear(KeyTravel& kt) {
+    for (uint8_t i = 0; i <= TravelMap::kSegments; i++) {
+        kt.knot[i] = (uint8_t)((255u * i + TravelMap::kSegments / 2) / TravelMap::kSegments);
+    }
+}
+} // namespace
+
+namespace TravelMap {
+
+void build(uint8_t m, uint8_t c, uint16_t rest, uint16_t peak) {
+    if (m >= N_MUX || c >= N_CH) return;
+    KeyTravel& kt = sTravel[m][c];
+    gTravelRest[m][c] = rest;
+    gTravelPeak[m][c] = peak;
+    if (peak == rest) peak = (uint16_t)(rest + 1);
+    kt.rest = rest;
+    kt.peak = peak;
+    // Le modèle n'est valable que si repos et pic sont du même côté de la sortie à champ nul
+    // et que le champ croît en enfonçant la touche.
+    const int q = (int)kHallQuiescent;
+    const int dRest = (int)rest - q;
+    const int dPeak = (int)peak - q;
+    const bool sameSide = (dRest > 0 && dPeak > 0) || (dRest < 0 && dPeak < 0);
+    if (!sameSide || abs(dRest) < (int)kMinFieldCounts || abs(dPeak) <= abs(dRest)) {
+        buildLinear(kt);
+        return;
+    }
+    const float aRest = relDistance((float)rest);
+    const float aPeak = relDistance((float)peak);
+    const float span = aRest - aPeak;
+    uint8_t prev = 0;
+    for (uint8_t i = 0; i <= kSegments; i++) {
+        float v = (float)rest + ((float)peak - (float)rest) * (float)i / (float)kSegments;
+        float frac = (aRest - relDistance(v)) / span;
+        if (frac < 0.f) frac = 0.f;
+        if (frac > 1.f) frac = 1.f;
+        uint8_t k = (uint8_t)(frac * 255.0f + 0.5f);
+        if (k < prev) k = prev; // monotone
+        kt.knot[i] = k;
+        prev = k;
+    }
+    kt.knot[0] = 0;
+    kt.knot[kSegments] = 255;
+}
+
+void buildFromThresholds(uint8_t m, uint8_t c) {
+    if (m >= N_MUX || c >= N_CH) return;
+    // Low = repos + s*max(min, pctL*D), High = pic - s*max(min, pctH*D), D = |pic - repos|
+    const int low = (int)gThLow[m][c];
+    const int high = (int)gThHigh[m][c];
+    const int s = (high >= low) ? +1 : -1;
+    const float D = (float)abs(high - low) / (1.0f - CalibCfg::kLowMarginPct - CalibCfg::kHighTargetMarginPct);
+    int lowMargin = (int)(CalibCfg::kLowMarginPct * D);
+    if (lowMargin < (int)CalibCfg::kLowMarginMinCounts) lowMargin = (int)CalibCfg::kLowMarginMinCounts;
+    int highMargin = (int)(CalibCfg::kHighTargetMarginPct * D);
+    if (highMargin < (int)CalibCfg::kHighTargetMarginMin) highMargin = (int)CalibCfg::kHighTargetMarginMin;
+    build(m, c, (uint16_t)clampAdc(low - s * lowMargin), (uint16_t)clampAdc(high + s * highMargin));
+}
+
+void buildAllFromThresholds() {
+    for (uint8_t m = 0; m < N_MUX; m++) {
+        for (uint8_t c = 0; c < N_CH; c++) {
+            buildFromThresholds(m, c);
+        }
+    }
+}
+
+void buildAllFromStored(const uint16_t rest[N_MUX][N_CH], const uint16_t peak[N_MUX][N_CH]) {
+    for (uint8_t m = 0; m < N_MUX; m++) {
+        for (uint8_t c = 0; c < N_CH; c++) {
+            build(m, c, rest[m][c], peak[m][c]);
+        }
+    }
+}
+
+void shift(uint8_t m, uint8_t c, int dRest, int dPeak) {
+    if (m >= N_MUX || c >= N_CH || (dRest == 0 && dPeak == 0)) return;
+    build(m, c, (uint16_t)clampAdc((int)gTravelRest[m][c] + dRest), (uint16_t)clampAdc((int)gTravelPeak[m][c] + dPeak));
+}
+
+void followRest(uint8_t m, uint8_t c, uint16_t rest) {
+    if (m >= N_MUX || c >= N_CH) return;
+    const int d = (int)rest - (int)gTravelRest[m][c];
+    shift(m, c, d, d);
+}
+
+uint16_t travelUm(uint8_t m, uint8_t c, uint16_t adc) {
+    if (m >= N_MUX || c >= N_CH) return 0;
+    const KeyTravel& kt = sTravel[m][c];
+    // Position Q4 le long des segments (0 .. kSegments*16)
+    const int32_t span = (int32_t)kt.peak - (int32_t)kt.rest;
+    int32_t x = ((int32_t)adc - (int32_t)kt.rest) * (int32_t)(kSegments * 16) / span;
+    if (x < 0) x = 0;
+    if (x > (int32_t)(kSegments * 16)) x = kSegments * 16;
+    const uint32_t i = (uint32_t)x >> 4;
+    const uint32_t f = (uint32_t)x & 15u;
+    uint32_t fracQ4 = (i >= kSegments) ? (uint32_t)kt.knot[kSegments] * 16u
+                                       : (uint32_t)kt.knot[i] * (16u - f) + (uint32_t)kt.knot[i + 1] * f;
+    return (uint16_t)((fracQ4 * kKeyTravelUm + (255u * 16u) / 2) / (255u * 16u));
+}
+
+} // namespace TravelMap
@@ -0,0 +1,136 @@
+#include "velocity_curves.h"
+#include "velocity_calc.h"
+#include "eeprom_store.h"
+
+// Runtime velocity gamma (adjustable via encoder), source of the gamma curve
+float gVelocityGamma = kVelocityGammaDefault;
+
+namespace VelocityCurves {
+
+uint8_t gLut[kCurveCount][kLutPoints];
+uint8_t gKeyCurve[N_MUX][N_CH];
+
+namespace {
+CurvePoints sPoints[kCurveCount];
+
+// Image EEPROM: points des courbes éditables + affectation par touche sur 4 bits
+struct Stored {
+    CurvePoints points[kCurveCount - 1];
+    uint8_t keyCurvePacked[kTotalKeys / 2];
+} __attribute__((packed));
+static_assert(kCurveCount <= 16, "key curve is packed on 4 bits");
+
+const char* const kNames[kCurveCount] = {"gamma", "linear", "soft", "hard"};
+
+void setDefaults() {
+    sPoints[kGamma] = CurvePoints{0, {}, {}};
+    sPoints[kLinear] = CurvePoints{2, {0, 255}, {1, 127}};
+    // Soft: les vitesses lentes montent vite en vélocité
+    sPoints[kSoft] = CurvePoints{4, {0, 64, 160, 255}, {1, 60, 105, 127}};
+    // Hard: il faut frapper fort pour les grandes vélocités
+    sPoints[kHard] = CurvePoints{4, {0, 96, 192, 255}, {1, 20, 70, 127}};
+    for (uint8_t m = 0; m < N_MUX; m++) {
+        for (uint8_t c = 0; c < N_CH; c++) gKeyCurve[m][c] = kGamma;
+    }
+}
+
+bool validPoints(const CurvePoints& p) {
+    if (p.n < 2 || p.n > kMaxPoints) return false;
+    for (uint8_t i = 0; i < p.n; i++) {
+        if (p.y[i] < 1 || p.y[i] > 127) return false;
+        if (i > 0 && p.x[i] <= p.x[i - 1]) return false;
+    }
+    return true;
+}
+
+void compilePiecewise(uint8_t curve) {
+    const CurvePoints& p = sPoints[curve];
+    uint8_t seg = 0;
+    for (uint16_t x = 0; x < kLutPoints; x++) {
+        uint8_t v;
+        if (x <= p.x[0]) {
+            v = p.y[0];
+        } else if (x >= p.x[p.n - 1]) {
+            v = p.y[p.n - 1];
+        } else {
+            while (seg + 1 < p.n - 1 && x > p.x[seg + 1]) seg++;
+            const int x0 = p.x[seg], x1 = p.x[seg + 1];
+            const int y0 = p.y[seg], y1 = p.y[seg + 1];
+            v = (uint8_t)(y0 + ((y1 - y0) * ((int)x - x0) + (x1 - x0) / 2) / (x1 - x0));
+        }
+        gLut[curve][x] = v;
+    }
+}
+} // namespace
+
+void rebuildGamma() {
+    // Même forme que l'ancienne courbe globale: 1 + norm^gamma * 126
+    for (uint16_t x = 0; x < kLutPoints; x++) {
+        float norm = powf((float)x / 256.0f, gVelocityGamma);
+        uint8_t vel = 1 + static_cast<uint8_t>(norm * 126.0f);
+        if (vel > 127) vel = 127;
+        gLut[kGamma][x] = vel;
+    }
+}
+
+void init() {
+    setDefaults();
+    Stored st;
+    if (EepromStore::loadSection(EepromStore::Section::Curves, &st, sizeof(st)) == sizeof(st)) {
+        for (uint8_t i = 1; i < kCurveCount; i++) {
+            if (validPoints(st.points[i - 1])) sPoints[i] = st.points[i - 1];
+        }
+        for (uint16_t k = 0; k < kTotalKeys; k++) {
+            uint8_t curve = (uint8_t)((st.keyCurvePacked[k >> 1] >> ((k & 1) * 4)) & 0x0F);
+            gKeyCurve[k / N_CH][k % N_CH] = (curve < kCurveCount) ? curve : kGamma;
+        }
+    }
+    rebuildGamma();
+    for (uint8_t i = 1; i < kCurveCount; i++) compilePiecewise(i);
+}
+
+bool setCurvePoints(uint8_t curve, const CurvePoints& pts) {
+    if (curve == kGamma || curve >= kCurveCount || !validPoints(pts)) return false;
+    sPoints[curve] = pts;
+    compilePiecewise(curve);
+    return true;
+}
+
+bool getCurvePoints(uint8_t curve, CurvePoints& out) {
+    if (curve == kGamma || curve >= kCurveCount) return false;
+    out = sPoints[curve];
+    return true;
+}
+
+void setKeyCurve(uint8_t mux, uint8_t ch, uint8_t curve) {
+    if (mux >= N_MUX || ch >= N_CH || curve >= kCurveCount) return;
+    gKeyCurve[mux][ch] = curve;
+}
+
+void setAllKeys(uint8_t curve) {
+    if (curve >= kCurveCount) return;
+    for (uint8_t m = 0; m < N_MUX; m++) {
+        for (uint8_t c = 0; c < N_CH; c++) gKeyCurve[m][c] = curve;
+    }
+}
+
+uint8_t keyCurve(uint8_t mux, uint8_t ch) {
+    if (mux >= N_MUX || ch >= N_CH) return kGamma;
+    return gKeyCurve[mux][ch];
+}
+
+const char* curveName(uint8_t curve) {
+    return (curve < kCurveCount) ? kNames[curve] : "?";
+}
+
+bool save() {
+    Stored st;
+    memset(&st, 0, sizeof(st));
+    for (uint8_t i = 1; i < kCurveCount; i++) st.points[i - 1] = sPoints[i];
+    for (uint16_t k = 0; k < kTotalKeys; k++) {
+        st.keyCurvePacked[k >> 1] |= (uint8_t)((gKeyCurve[k / N_CH][k % N_CH] & 0x0F) << ((k & 1) * 4));
+    }
+    return EepromStore::saveSection(EepromStore::Section::Curves, &st, sizeof(st));
+}
+
+} // namespace VelocityCurves
@@ -1,13 +1,73 @@
 #include "velocity_engine.h"
 #include "velocity_calc.h"
+#include "velocity_eq.h"
+#include "stroke_speed.h"
+#include "travel_map.h"
 #include "config.h"
 #include "calibration.h"
-#include "midi_out.h"
+#include "key_events.h"
+#include "key_health.h"
 
 // === Global State Arrays Definition ===
 KeyData g_keys[N_MUX][N_CH];
 AcquisitionData g_acquisition;
 
+// === Quiescent-key prefilter ===
+// Bande « repos » par touche, rangée [channel][mux] pour que les 8 bornes d'un channel
+// tiennent dans 4 mots de 32 bits (2 x uint16 par mot), comme les 8 échantillons.
+// Une touche IDLE est « au repos » tant que l'échantillon reste du côté repos de thLow:
+//   polarité +1 : [0, thLow-1]      polarité -1 : [thLow+1, 0xFFFF]
+// Toute autre touche (TRACKING/HELD/REARMED) a une bande vide (lo > hi) → FSM complète.
+// Une touche exclue par KeyHealth a la bande pleine [0, 0xFFFF]: jamais de FSM.
+static_assert(N_MUX == 8, "Prefilter packs exactly 8 MUX samples into 4 words");
+alignas(8) static uint16_t sQuietLo[N_CH][N_MUX];
+alignas(8) static uint16_t sQuietHi[N_CH][N_MUX];
+// Franchissement du seuil médian chronométré pour la vélocité 3 points et pour le profil de
+// frappe, que le CC74 MPE transmet même quand la vélocité reste en 2 points
+static constexpr bool kTimeMidCrossing = kVelocityThreePoint || kMpeMode;
+#if DEBUG_PROFILE_SCAN
+static uint32_t sProfileFsmRuns = 0;
+static uint32_t sProfileQuietSkips = 0;
+#endif
+#if DEBUG_VELOCITY_COMPARE
+// Capture 2 points / 3 points remplie dans le scan, vidée sur Serial depuis loop()
+struct VelCompare { uint8_t mux, channel, two, three, profile, mid; uint32_t dt; };
+static constexpr uint8_t kVelCompareDepth = 16; // puissance de 2
+static VelCompare sVelCompare[kVelCompareDepth];
+static uint8_t sVelCompareHead = 0;
+static uint8_t sVelCompareTail = 0;
+static uint32_t sVelCompareDropped = 0;
+#endif
+
+// Compare 2 échantillons 16 bits empaquetés à leurs bandes [lo, hi].
+// Retourne 0xFFFF dans chaque demi-mot dont l'échantillon est dans sa bande, 0 sinon.
+static inline uint32_t packedInBand(uint32_t v, uint32_t lo, uint32_t hi) {
+#if defined(__ARM_FEATURE_SIMD32)
+    // Cortex-M7 DSP: USUB16 positionne les flags GE par demi-mot (pas d'emprunt ⇔ a >= b),
+    // SEL matérialise ces flags en masque. Un seul bloc asm pour que rien ne s'intercale
+    // entre USUB16 et SEL.
+    uint32_t t, m, r;
+    __asm__ ("usub16 %[t], %[v], %[lo]\n\t"
+             "sel    %[m], %[ones], %[zero]\n\t"
+             "usub16 %[t], %[hi], %[v]\n\t"
+             "sel    %[r], %[m], %[zero]"
+             : [t] "=&r" (t), [m] "=&r" (m), [r] "=&r" (r)
+             : [v] "r" (v), [lo] "r" (lo), [hi] "r" (hi),
+               [ones] "r" (0xFFFFFFFFu), [zero] "r" (0u));
+    return r;
+#else
+    // Portable fallback (host builds)
+    uint32_t r = 0;
+    for (int h = 0; h < 2; ++h) {
+        const uint16_t vv = (uint16_t)(v >> (16 * h));
+        const uint16_t l  = (uint16_t)(lo >> (16 * h));
+        const uint16_t u  = (uint16_t)(hi >> (16 * h));
+        if (vv >= l && vv <= u) r |= 0xFFFFu << (16 * h);
+    }
+    return r;
+#endif
+}
+
 // === VelocityEngine Implementation ===
 
 void VelocityEngine::initialize() {
@@ -20,8 +80,105 @@ void VelocityEngine::initialize() {
     
     // Zero acquisition buffers (value-initialize to avoid class-memaccess warnings)
     g_acquisition = AcquisitionData{};
+    // Prefilter bands follow current thresholds (refreshed again once calibration is loaded)
+    refreshAllQuietBands();
+}
+
+void VelocityEngine::openQuietBand(uint8_t mux, uint8_t channel) {
+    const uint16_t thLow  = calibLow(mux, channel);
+    const uint16_t thHigh = calibHigh(mux, channel);
+    if (thHigh >= thLow) {
+        // Press increases ADC: quiet below thLow (empty band if thLow == 0)
+        sQuietLo[channel][mux] = (thLow > 0) ? 0 : 0xFFFF;
+        sQuietHi[channel][mux] = (thLow > 0) ? (uint16_t)(thLow - 1) : 0;
+    } else {
+        // Inverted polarity: quiet above thLow
+        sQuietLo[channel][mux] = (uint16_t)(thLow + 1);
+        sQuietHi[channel][mux] = 0xFFFF;
+    }
 }
 
+void VelocityEngine::closeQuietBand(uint8_t mux, uint8_t channel) {
+    sQuietLo[channel][mux] = 0xFFFF;
+    sQuietHi[channel][mux] = 0;
+}
+
+void VelocityEngine::refreshQuietBand(uint8_t mux, uint8_t channel) {
+    if (mux >= N_MUX || channel >= N_CH) return;
+    if (KeyHealth::excluded(mux, channel)) {
+        sQuietLo[channel][mux] = 0;
+        sQuietHi[channel][mux] = 0xFFFF;
+    } else if (g_keys[mux][channel].state == KeyState::IDLE) openQuietBand(mux, channel);
+    else closeQuietBand(mux, channel);
+}
+
+void VelocityEngine::setKeyExcluded(uint8_t mux, uint8_t channel, bool excluded, uint32_t timestamp_us) {
+    if (mux >= N_MUX || channel >= N_CH) return;
+    KeyData& key = g_keys[mux][channel];
+    if (excluded) {
+        if (key.note_on_sent) publishRelease(mux, channel, timestamp_us);
+        resetKey(key);
+    }
+    refreshQuietBand(mux, channel);
+}
+
+void VelocityEngine::refreshAllQuietBands() {
+    for (uint8_t mux = 0; mux < N_MUX; mux++) {
+        for (uint8_t channel = 0; channel < N_CH; channel++) {
+            refreshQuietBand(mux, channel);
+        }
+    }
+}
+
+void VelocityEngine::processChannel(uint8_t channel, const uint16_t values[N_MUX], uint32_t timestamp_us) {
+    if (channel >= N_CH) {
+        return;
+    }
+    // Calibration Phase2: every sample feeds the peak tracker (no-op branch otherwise)
+    calibrationPeakHook(channel, values);
+    // Pack the 8 samples into 4 registers and compare them to their bands in one pass
+    const uint16_t* lo = sQuietLo[channel];
+    const uint16_t* hi = sQuietHi[channel];
+    uint32_t mask[N_MUX / 2];
+    for (uint8_t w = 0; w < N_MUX / 2; w++) {
+        const uint32_t v  = (uint32_t)values[2 * w] | ((uint32_t)values[2 * w + 1] << 16);
+        const uint32_t l  = (uint32_t)lo[2 * w]     | ((uint32_t)lo[2 * w + 1] << 16);
+        const uint32_t h  = (uint32_t)hi[2 * w]     | ((uint32_t)hi[2 * w + 1] << 16);
+        mask[w] = packedInBand(v, l, h);
+    }
+    const bool allQuiet = (mask[0] & mask[1] & mask[2] & mask[3]) == 0xFFFFFFFFu;
+
+    for (uint8_t mux = 0; mux < N_MUX; mux++) {
+        const uint16_t adc_value = values[mux];
+        g_acquisition.workingValues[mux][channel] = adc_value;
+        g_acquisition.t_sample_us[mux][channel] = timestamp_us;
+        KeyData& key = g_keys[mux][channel];
+        const bool quiet = allQuiet || ((mask[mux >> 1] >> ((mux & 1) * 16)) & 1u);
+        if (quiet) {
+            // Resting IDLE key: the FSM would only record the sample
+            key.last_adc = adc_value;
+            key.last_sample_us = timestamp_us;
+#if DEBUG_PROFILE_SCAN
+            sProfileQuietSkips++;
+#endif
+        } else {
+            runStateMachine(mux, channel, key, adc_value, timestamp_us);
+#if DEBUG_PROFILE_SCAN
+            sProfileFsmRuns++;
+#endif
+        }
+    }
+}
+
+#if DEBUG_PROFILE_SCAN
+void VelocityEngine::takeProfileCounters(uint32_t& fsmRuns, uint32_t& quietSkips) {
+    fsmRuns = sProfileFsmRuns;
+    quietSkips = sProfileQuietSkips;
+    sProfileFsmRuns = 0;
+    sProfileQuietSkips = 0;
+}
+#endif
+
 void VelocityEngine::processKey(uint8_t mux, uint8_t channel, 
                                uint16_t adc_value, uint32_t timestamp_us) {
     // Bounds checking
@@ -32,7 +189,11 @@ void VelocityEngine::processKey(uint8_t mux, uint8_t channel,
     g_acquisition.workingValues[mux][channel] = adc_value;
     g_acquisition.t_sample_us[mux][channel] = timestamp_us;
     
-    KeyData& key = g_keys[mux][channel];
+    runStateMachine(mux, channel, g_keys[mux][channel], adc_value, timestamp_us);
+}
+
+void VelocityEngine::runStateMachine(uint8_t mux, uint8_t channel, KeyData& key,
+                                     uint16_t adc_value, uint32_t timestamp_us) {
     //KeyState oldState = key.state; // unused in release
     
     // Preserve previous measurement for edge detection
@@ -60,38 +221,46 @@ void VelocityEngine::processKey(uint8_t mux, uint8_t channel,
                 key.t_start_us = timestamp_us;
                 key.current_velocity = 0;
                 key.peak_adc = adc_value; // nouveau champ (sera ajouté dans struct)
+                key.mid_seen = false;
+                closeQuietBand(mux, channel);
             }
             break;
         case KeyState::TRACKING: {
             // Abort if we returned past ThresholdLow opposite the press direction
             if (sCmp((int)adc_value - (int)thLow) < 0) {
                 resetKey(key);
+                openQuietBand(mux, channel);
                 break;
             }
             // Update peak along the press direction
             if (sCmp((int)adc_value - (int)key.peak_adc) > 0) key.peak_adc = adc_value;
+            // Three-point timing: first sample past the intermediate threshold
+            if (kTimeMidCrossing && !key.mid_seen &&
+                sCmp((int)adc_value - (((int)thLow + (int)thHigh) >> 1)) >= 0) {
+                key.mid_seen = true;
+                key.adc_mid = adc_value;
+                key.t_mid_us = timestamp_us;
+            }
             // Trigger when crossing ThresholdHigh in the press direction
             if (sCmp((int)adc_value - (int)thHigh) >= 0) {
-                int8_t note = effectiveNote(mux, channel);
-                if (note == DISABLED) { resetKey(key); break; }
-                int delta_s = sCmp((int)adc_value - (int)key.adc_start);
-                uint16_t delta_adc = (delta_s > 0) ? (uint16_t)delta_s : 1;
-                uint32_t dt = (timestamp_us > key.t_start_us) ? (timestamp_us - key.t_start_us) : 1;
-                uint8_t velocity = computeVelocity(delta_adc, dt);
-                sendNoteOn((uint8_t)note, velocity, mux, channel);
+                uint8_t velocity = strokeVelocity(mux, channel, key, adc_value, timestamp_us, s);
+                // Note resolution (layout, transpose) is done by the output subscribers
+                publishPress(mux, channel, velocity, timestamp_us);
                 key.note_on_sent = true;
-                key.current_note = (uint8_t)note;
                 key.current_velocity = velocity;
                 key.state = KeyState::HELD;
+                key.pressure = 0;
+                key.t_pressure_us = timestamp_us;
                 key.total_triggers++;
             }
             break; }
         case KeyState::HELD:
             if (sCmp((int)adc_value - (int)key.peak_adc) > 0) key.peak_adc = adc_value;
+            if (kMpeMode) trackPressure(mux, channel, key, adc_value, thHigh, timestamp_us);
             // Release when crossing release threshold opposite the press direction
             if (sCmp((int)adc_value - (int)thRel) < 0) {
                 // Note considered released (hysteresis), transition to REARMED
-                sendNoteOff(key.current_note, mux, channel);
+                publishRelease(mux, channel, timestamp_us);
                 key.note_on_sent = false;
                 // Update adaptive High peak per key
                 updateHighAfterNote(mux, channel, key.peak_adc);
@@ -114,6 +283,7 @@ void VelocityEngine::processKey(uint8_t mux, uint8_t channel,
             // If fully released deeply (moved 10 counts opposite the press direction), go back to IDLE
             if (sCmp((int)adc_value - (int)thLow) <= -10) {
                 key.state = KeyState::IDLE;
+                openQuietBand(mux, channel);
                 break;
             }
 
@@ -134,6 +304,10 @@ void VelocityEngine::processKey(uint8_t mux, uint8_t channel,
                     key.t_start_us = key.rearm_min_t_us;
                     key.current_velocity = 0;
                     key.peak_adc = adc_value;
+                    // Valley already past mid: no mid crossing to time, mark it seen at t_start
+                    // so strokeVelocity falls back to two-point
+                    key.mid_seen = sCmp((int)key.rearm_min_adc - (((int)thLow + (int)thHigh) >> 1)) >= 0;
+                    key.t_mid_us = key.t_start_us;
                     key.stable_up_count = 0;
                     key.stable_down_count = 0;
                 }
@@ -152,21 +326,97 @@ void VelocityEngine::processKey(uint8_t mux, uint8_t channel,
 
 // Removed advanced handlers & velocity math (simplified inline in processKey switch)
 
-void VelocityEngine::sendNoteOn(uint8_t note, uint8_t velocity, uint8_t mux, uint8_t channel) {
-    MidiOut::Event ev{MidiOut::Kind::NoteOn, kMidiChannel, note, velocity};
-    if (!MidiOut::enqueue(ev)) {
-        // Fallback to immediate send to avoid missed notes if queue is saturated
-        usbMIDI.sendNoteOn(note, velocity, kMidiChannel);
-        usbMIDI.send_now();
+uint16_t VelocityEngine::strokeDelta(uint8_t mux, uint8_t channel, uint16_t adc_from, uint16_t adc_to, int s) {
+    int d;
+    if (kVelocityUseTravel) {
+        // Physical stroke: hall reading linearized to travel (µm) per key
+        d = (int)TravelMap::travelUm(mux, channel, adc_to) - (int)TravelMap::travelUm(mux, channel, adc_from);
+    } else {
+        d = s * ((int)adc_to - (int)adc_from);
+    }
+    return (d > 0) ? (uint16_t)d : 1;
+}
+
+uint8_t VelocityEngine::strokeVelocity(uint8_t mux, uint8_t channel, KeyData& key,
+                                       uint16_t adc_value, uint32_t timestamp_us, int s) {
+    uint32_t dt = (timestamp_us > key.t_start_us) ? (timestamp_us - key.t_start_us) : 1;
+    uint16_t delta = strokeDelta(mux, channel, key.adc_start, adc_value, s);
+    uint16_t deltaFused = delta; // two-point by default
+    key.stroke_profile = 64;
+    const bool midTimed = kTimeMidCrossing && key.mid_seen &&
+                          key.t_mid_us > key.t_start_us && timestamp_us > key.t_mid_us;
+    const bool threePoint = kVelocityThreePoint && midTimed;
+    if (midTimed) {
+        // Two timed segments: start→mid and mid→high
+        const StrokeSegments seg{strokeDelta(mux, channel, key.adc_start, key.adc_mid, s), key.t_mid_us - key.t_start_us,
+                                 strokeDelta(mux, channel, key.adc_mid, adc_value, s), timestamp_us - key.t_mid_us};
+        key.stroke_profile = strokeProfile(seg);
+        // Fused speed leans on the final segment
+        if (threePoint) deltaFused = threePointDelta(seg, dt, kThreePointLateWeight);
+    }
+    // Per-key gain learned from playing equalizes sensor/magnet differences
+    const uint16_t deltaEq = VelocityEq::apply(mux, channel, deltaFused, dt);
+    // Key's velocity curve (per key / zone), compiled lookup table
+    const uint8_t velocity = computeVelocity(mux, channel, deltaEq, dt);
+#if DEBUG_VELOCITY_COMPARE
+    const uint8_t next = (uint8_t)((sVelCompareHead + 1) & (kVelCompareDepth - 1));
+    if (next != sVelCompareTail) {
+        // Same gain and curve as the played path (scale() does not learn from the stroke again)
+        const uint8_t two = threePoint ? computeVelocity(mux, channel, VelocityEq::scale(mux, channel, delta), dt)
+                                       : velocity;
+        sVelCompare[sVelCompareHead] = VelCompare{mux, channel, two, velocity,
+                                                  key.stroke_profile, (uint8_t)threePoint, dt};
+        sVelCompareHead = next;
+    } else {
+        sVelCompareDropped++;
+    }
+#endif
+    return velocity;
+}
+
+#if DEBUG_VELOCITY_COMPARE
+void VelocityEngine::dumpVelocityCompare() {
+    while (sVelCompareTail != sVelCompareHead) {
+        const VelCompare& c = sVelCompare[sVelCompareTail];
+        Serial.printf("[VEL] key=%u,%u dt=%lu two=%u three=%u profile=%u mid=%u\n",
+                      c.mux, c.channel, (unsigned long)c.dt, c.two, c.three, c.profile, c.mid);
+        sVelCompareTail = (uint8_t)((sVelCompareTail + 1) & (kVelCompareDepth - 1));
     }
+    if (sVelCompareDropped) {
+        Serial.printf("[VEL] dropped=%lu\n", (unsigned long)sVelCompareDropped);
+        sVelCompareDropped = 0;
+    }
+}
+#endif
+
+void VelocityEngine::publishPress(uint8_t mux, uint8_t channel, uint8_t velocity, uint32_t timestamp_us) {
+    KeyEvents::KeyEvent ev{KeyEvents::keyIndex(mux, channel), KeyEvents::Kind::Press, velocity,
+                           g_keys[mux][channel].stroke_profile, timestamp_us};
+    KeyEvents::publish(ev);
 }
 
-void VelocityEngine::sendNoteOff(uint8_t note, uint8_t mux, uint8_t channel) {
-    MidiOut::Event ev{MidiOut::Kind::NoteOff, kMidiChannel, note, 0};
-    if (!MidiOut::enqueue(ev)) {
-        // Fallback to immediate send to avoid stuck notes
-        usbMIDI.sendNoteOff(note, 0, kMidiChannel);
-        usbMIDI.send_now();
+void VelocityEngine::publishRelease(uint8_t mux, uint8_t channel, uint32_t timestamp_us) {
+    KeyEvents::KeyEvent ev{KeyEvents::keyIndex(mux, channel), KeyEvents::Kind::Release, 0, 0, timestamp_us};
+    KeyEvents::publish(ev);
+}
+
+void VelocityEngine::trackPressure(uint8_t mux, uint8_t channel, KeyData& key, uint16_t adc_value,
+                                   uint16_t thHigh, uint32_t timestamp_us) {
+    if ((uint32_t)(timestamp_us - key.t_pressure_us) < kPressureIntervalUs) return;
+    // Depth past the trigger point, normalized to the remaining physical travel
+    const uint16_t trig = TravelMap::travelUm(mux, channel, thHigh);
+    const uint16_t now  = TravelMap::travelUm(mux, channel, adc_value);
+    uint8_t p = 0;
+    if (now > trig && trig < TravelMap::kKeyTravelUm) {
+        uint32_t q = (uint32_t)(now - trig) * 127u / (uint32_t)(TravelMap::kKeyTravelUm - trig);
+        p = (q > 127u) ? 127 : (uint8_t)q;
+    }
+    const int diff = (int)p - (int)key.pressure;
+    if (diff < kPressureMinStep && diff > -(int)kPressureMinStep) return;
+    KeyEvents::KeyEvent ev{KeyEvents::keyIndex(mux, channel), KeyEvents::Kind::Pressure, 0, p, timestamp_us};
+    if (KeyEvents::publish(ev)) {
+        key.pressure = p;
+        key.t_pressure_us = timestamp_us;
     }
 }
 
@@ -178,6 +428,9 @@ void VelocityEngine::resetKey(KeyData& key) {
     key.current_note = 0;
     key.current_velocity = 0;
     key.peak_adc = 0;
+    key.mid_seen = false;
+    key.adc_mid = 0;
+    key.t_mid_us = 0;
     key.rearm_min_adc = 0;
     key.rearm_min_t_us = 0;
 }
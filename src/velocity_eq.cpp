@@ -0,0 +1,121 @@
+#include "velocity_eq.h"
+#include "eeprom_store.h"
+#include <algorithm>
+
+namespace {
+// Vitesse en Q12 unités/µs, saturée à 16 bits
+// (ADC: 0.05 counts/µs → 205; course: 1 µm/µs → 4096)
+struct EqState {
+    uint16_t p90;   // estimation du 90e percentile de vitesse
+    uint8_t  notes; // nombre de frappes observées (saturé à 255)
+} __attribute__((packed));
+static_assert(sizeof(EqState) == 3, "EqState is persisted as 3 bytes per key");
+
+EqState sState[N_MUX][N_CH];
+uint16_t sGainQ8[N_MUX][N_CH];
+bool sDirty = false;
+uint32_t sLastRecomputeMs = 0;
+
+inline uint16_t speedQ12(uint16_t delta, uint32_t dt_us) {
+    if (dt_us == 0) dt_us = 1;
+    uint32_t q = ((uint32_t)delta << 12) / dt_us;
+    return (q > 0xFFFFu) ? 0xFFFFu : (uint16_t)q;
+}
+
+// Estimateur de quantile p=0.9: au-dessus on monte de 9 pas, en dessous on descend d'un pas,
+// équilibre quand P(x > q) = 10%. Pas proportionnel à q (~1.5%) pour une convergence relative.
+inline void updateP90(EqState& st, uint16_t x) {
+    if (st.notes == 0) {
+        st.p90 = x;
+    } else {
+        const uint32_t step = std::max<uint32_t>(1u, st.p90 >> 6);
+        if (x > st.p90) {
+            uint32_t up = st.p90 + 9u * step;
+            st.p90 = (uint16_t)std::min<uint32_t>(up, x);
+        } else if (x < st.p90) {
+            st.p90 = (st.p90 > step) ? (uint16_t)(st.p90 - step) : 1u;
+        }
+    }
+    if (st.notes < 255) st.notes++;
+}
+
+void recomputeGains() {
+    // Référence = médiane des p90 des touches suffisamment jouées
+    uint16_t vals[kTotalKeys];
+    uint16_t n = 0;
+    for (uint8_t m = 0; m < N_MUX; m++) {
+        for (uint8_t c = 0; c < N_CH; c++) {
+            if (sState[m][c].notes >= VelocityEq::kMinNotes && sState[m][c].p90 > 0) vals[n++] = sState[m][c].p90;
+        }
+    }
+    if (n == 0) return;
+    std::nth_element(vals, vals + n / 2, vals + n);
+    const uint32_t ref = vals[n / 2];
+    for (uint8_t m = 0; m < N_MUX; m++) {
+        for (uint8_t c = 0; c < N_CH; c++) {
+            const EqState& st = sState[m][c];
+            uint32_t g = 256;
+            if (st.notes >= VelocityEq::kMinNotes && st.p90 > 0) {
+                g = (ref * 256u + st.p90 / 2) / st.p90;
+                if (g < VelocityEq::kGainMinQ8) g = VelocityEq::kGainMinQ8;
+                if (g > VelocityEq::kGainMaxQ8) g = VelocityEq::kGainMaxQ8;
+            }
+            sGainQ8[m][c] = (uint16_t)g;
+        }
+    }
+}
+} // namespace
+
+namespace VelocityEq {
+
+void reset() {
+    for (uint8_t m = 0; m < N_MUX; m++) {
+        for (uint8_t c = 0; c < N_CH; c++) {
+            sState[m][c] = EqState{0, 0};
+            sGainQ8[m][c] = 256;
+        }
+    }
+    sDirty = false;
+}
+
+void init() {
+    reset();
+    if (EepromStore::loadBlock(EepromStore::Block::SpeedEq, sState, sizeof(sState))) {
+        recomputeGains();
+    } else {
+        reset();
+    }
+}
+
+uint16_t apply(uint8_t mux, uint8_t ch, uint16_t delta_adc, uint32_t dt_us) {
+    if (mux >= N_MUX || ch >= N_CH) return delta_adc;
+    updateP90(sState[mux][ch], speedQ12(delta_adc, dt_us));
+    sDirty = true;
+    return scale(mux, ch, delta_adc);
+}
+
+uint16_t scale(uint8_t mux, uint8_t ch, uint16_t delta_adc) {
+    if (mux >= N_MUX || ch >= N_CH) return delta_adc;
+    uint32_t d = ((uint32_t)delta_adc * sGainQ8[mux][ch] + 128u) >> 8;
+    if (d < 1) d = 1;
+    if (d > 0xFFFFu) d = 0xFFFFu;
+    return (uint16_t)d;
+}
+
+void service(uint32_t nowMs) {
+    if (!sDirty || (nowMs - sLastRecomputeMs) < kRecomputeMs) return;
+    sLastRecomputeMs = nowMs;
+    sDirty = false;
+    recomputeGains();
+}
+
+void save() {
+    EepromStore::saveBlock(EepromStore::Block::SpeedEq, sState, sizeof(sState));
+}
+
+uint16_t gainQ8(uint8_t mux, uint8_t ch) {
+    if (mux >= N_MUX || ch >= N_CH) return 256;
+    return sGainQ8[mux][ch];
+}
+
+} // namespace VelocityEq
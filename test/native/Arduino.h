@@ -0,0 +1,12 @@
+#pragma once
+// Host build (pio test -e native): the few Arduino definitions used by the modules under test
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+// Simulated clock, advanced by the tests
+inline uint32_t gHostMicros = 0;
+inline uint32_t micros() { return gHostMicros; }
+inline uint32_t millis() { return gHostMicros / 1000u; }
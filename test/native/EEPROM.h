@@ -0,0 +1,23 @@
+#pragma once
+// Host build: RAM-backed EEPROM with the Teensy 4 size and access counters. mem may point to
+// memory shared with a forked process (simulated reboot).
+#include <stdint.h>
+#include <string.h>
+
+struct HostEeprom {
+    static constexpr int kSize = 4284;
+    uint8_t* mem = nullptr;
+    uint32_t reads = 0;
+    uint32_t writes = 0;
+
+    uint8_t read(int a) { reads++; return mem[a]; }
+    void write(int a, uint8_t v) { writes++; mem[a] = v; }
+    void update(int a, uint8_t v) { if (read(a) != v) write(a, v); }
+    int length() { return kSize; }
+    template <class T> T& get(int a, T& t) { memcpy(&t, mem + a, sizeof(T)); reads += sizeof(T); return t; }
+    template <class T> const T& put(int a, const T& t) {
+        for (size_t i = 0; i < sizeof(T); i++) update(a + (int)i, ((const uint8_t*)&t)[i]);
+        return t;
+    }
+};
+inline HostEeprom EEPROM;
@@ -0,0 +1,42 @@
+#pragma once
+// Host build: simulated power cycles. Each boot() runs in a forked process, so every module
+// starts from its power-on state, while the EEPROM content lives in memory shared with the
+// test process. A boot that returns early is a power loss at that point.
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <EEPROM.h>
+
+struct HostShared {
+    uint8_t mem[HostEeprom::kSize];
+    int failLine;      // BOOT_CHECK that failed in the last boot, 0 = none
+    uint32_t values[8]; // results reported by a boot
+};
+inline HostShared* gShared = nullptr;
+
+// Blank (erased) EEPROM
+inline void hostEepromErase() {
+    if (!gShared) {
+        gShared = (HostShared*)mmap(nullptr, sizeof(HostShared), PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    }
+    memset(gShared->mem, 0xFF, sizeof(gShared->mem));
+    EEPROM.mem = gShared->mem;
+}
+
+#define BOOT_CHECK(c) do { if (!(c)) { gShared->failLine = __LINE__; _exit(1); } } while (0)
+
+// Runs fn as one power-on; returns the failing BOOT_CHECK line (0 = all passed)
+template <class F> int boot(F fn) {
+    gShared->failLine = 0;
+    fflush(stdout);
+    const pid_t pid = fork();
+    if (pid == 0) {
+        fn();
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (gShared->failLine) return gShared->failLine;
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : -1;
+}
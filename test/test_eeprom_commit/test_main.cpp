@@ -0,0 +1,169 @@
+// Moteur de commit EEPROM (eeprom_store.cpp) sur une EEPROM RAM: emplacement cible, diff
+// contre la copie RAM de l'emplacement, budget de lectures, coupure d'alimentation pendant
+// un commit, instantané remplacé en cours d'écriture. Chaque boot() est un démarrage à froid.
+#include <unity.h>
+#include <host_boot.h>
+#include "eeprom_store.h"
+
+namespace {
+constexpr uint16_t kConfigA = 0, kConfigB = 3380;
+constexpr uint32_t kConfigMagic = 0x4A324346; // 'J2CF'
+constexpr uint16_t kBytesPerCall = 16;
+
+uint16_t sLow[N_MUX][N_CH], sHigh[N_MUX][N_CH], sRest[N_MUX][N_CH], sPeak[N_MUX][N_CH];
+
+// Plausible calibration, shifted by seed
+void fill(uint16_t seed) {
+    for (uint8_t m = 0; m < N_MUX; m++) {
+        for (uint8_t c = 0; c < N_CH; c++) {
+            const uint16_t k = (uint16_t)(m * N_CH + c);
+            sRest[m][c] = (uint16_t)(150 + (k * 7 + seed) % 60);
+            sLow[m][c] = (uint16_t)(sRest[m][c] + 40);
+            sPeak[m][c] = (uint16_t)(800 + (k * 3 + seed) % 150);
+            sHigh[m][c] = (uint16_t)(sPeak[m][c] - 60);
+        }
+    }
+}
+
+bool matches(uint16_t seed) {
+    fill(seed);
+    uint16_t low[N_MUX][N_CH], high[N_MUX][N_CH], rest[N_MUX][N_CH], peak[N_MUX][N_CH];
+    if (!EepromStore::load(low, high) || !EepromStore::loadTravel(rest, peak)) return false;
+    return memcmp(low, sLow, sizeof(low)) == 0 && memcmp(high, sHigh, sizeof(high)) == 0 &&
+           memcmp(rest, sRest, sizeof(rest)) == 0 && memcmp(peak, sPeak, sizeof(peak)) == 0;
+}
+
+bool save(uint16_t seed) {
+    fill(seed);
+    return EepromStore::beginSave(sLow, sHigh, sRest, sPeak);
+}
+
+// Service until committed; returns the number of calls
+uint32_t commit() {
+    uint32_t calls = 0;
+    while (EepromStore::saveBusy() && calls < 100000) {
+        EepromStore::service(kBytesPerCall);
+        calls++;
+    }
+    return calls;
+}
+
+uint32_t magicAt(uint16_t off) {
+    uint32_t m;
+    memcpy(&m, gShared->mem + off, sizeof(m));
+    return m;
+}
+
+// Blank board, then one committed save of calibration `seed`
+void provision(uint16_t seed) {
+    hostEepromErase();
+    TEST_ASSERT_EQUAL(0, boot([seed] {
+        BOOT_CHECK(save(seed));
+        commit();
+        BOOT_CHECK(!EepromStore::saveBusy());
+    }));
+}
+}
+
+void setUp() {}
+void tearDown() {}
+
+// First record goes to B: A may still hold data from earlier firmware
+void test_first_save_goes_to_b() {
+    hostEepromErase();
+    TEST_ASSERT_EQUAL(0, boot([] {
+        BOOT_CHECK(!matches(1)); // blank: nothing to load
+        BOOT_CHECK(save(1));
+        commit();
+        EepromStore::Stats st;
+        EepromStore::getStats(st);
+        BOOT_CHECK(st.commits == 1);
+    }));
+    TEST_ASSERT_EQUAL_HEX32(kConfigMagic, magicAt(kConfigB));
+    TEST_ASSERT_EQUAL_HEX32(0xFFFFFFFFu, magicAt(kConfigA));
+    TEST_ASSERT_EQUAL(0, boot([] { BOOT_CHECK(matches(1)); }));
+}
+
+// Slots alternate; a one-key change rewrites that key and the header only, diffed from RAM
+void test_one_key_change_writes_few_bytes_without_reads() {
+    provision(1);
+    TEST_ASSERT_EQUAL(0, boot([] {
+        BOOT_CHECK(save(1));
+        commit(); // into A (blank): full write
+        BOOT_CHECK(save(1));
+        sLow[3][5] = (uint16_t)(sLow[3][5] + 1);
+        BOOT_CHECK(EepromStore::beginSave(sLow, sHigh, sRest, sPeak));
+        const uint32_t reads0 = EEPROM.reads;
+        commit(); // into B, read at boot: known in RAM
+        gShared->values[0] = EEPROM.reads - reads0;
+        EepromStore::Stats st;
+        EepromStore::getStats(st);
+        gShared->values[1] = st.lastCommitWritten;
+    }));
+    TEST_ASSERT_EQUAL_UINT32(0, gShared->values[0]);
+    // 1 key (5 packed bytes at most) + gen + CRC
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(10, gShared->values[1]);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, gShared->values[1]);
+}
+
+// After a reboot the inactive slot is not in RAM: at most kEepromComparesPerLoop reads per call
+void test_reads_per_call_are_budgeted() {
+    provision(1);
+    TEST_ASSERT_EQUAL(0, boot([] { BOOT_CHECK(save(1)); commit(); })); // A, B both valid
+    TEST_ASSERT_EQUAL(0, boot([] {
+        BOOT_CHECK(save(2));
+        uint32_t worst = 0, calls = 0;
+        while (EepromStore::saveBusy() && calls < 100000) {
+            const uint32_t r0 = EEPROM.reads;
+            EepromStore::service(kBytesPerCall);
+            if (EEPROM.reads - r0 > worst) worst = EEPROM.reads - r0;
+            calls++;
+        }
+        BOOT_CHECK(!EepromStore::saveBusy());
+        gShared->values[0] = worst;
+    }));
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(kEepromComparesPerLoop, gShared->values[0]);
+    TEST_ASSERT_EQUAL(0, boot([] { BOOT_CHECK(matches(2)); }));
+}
+
+// Power lost in the middle of a commit: the previous record is still the one loaded
+void test_interrupted_commit_keeps_previous() {
+    provision(1);
+    // Cut after `cut` flash writes, header included (the last bytes written)
+    const uint32_t cuts[] = {1, 50, 200, 400};
+    for (uint32_t cut : cuts) {
+        TEST_ASSERT_EQUAL(0, boot([cut] {
+            BOOT_CHECK(save(2));
+            const uint32_t w0 = EEPROM.writes;
+            while (EepromStore::saveBusy() && EEPROM.writes - w0 < cut) EepromStore::service(1);
+            BOOT_CHECK(EepromStore::saveBusy());
+        }));
+        TEST_ASSERT_EQUAL(0, boot([] { BOOT_CHECK(matches(1)); }));
+    }
+}
+
+// A newer snapshot replaces the one being written; the newest is what gets committed
+void test_restart_commits_newest_snapshot() {
+    provision(1);
+    TEST_ASSERT_EQUAL(0, boot([] {
+        BOOT_CHECK(save(2));
+        for (int i = 0; i < 5; i++) EepromStore::service(kBytesPerCall);
+        BOOT_CHECK(save(3));
+        commit();
+        EepromStore::Stats st;
+        EepromStore::getStats(st);
+        BOOT_CHECK(st.restarts == 1 && st.commits == 1);
+        BOOT_CHECK(matches(3));
+    }));
+    TEST_ASSERT_EQUAL(0, boot([] { BOOT_CHECK(matches(3)); }));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_save_goes_to_b);
+    RUN_TEST(test_one_key_change_writes_few_bytes_without_reads);
+    RUN_TEST(test_reads_per_call_are_budgeted);
+    RUN_TEST(test_interrupted_commit_keeps_previous);
+    RUN_TEST(test_restart_commits_newest_snapshot);
+    return UNITY_END();
+}
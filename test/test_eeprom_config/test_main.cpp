@@ -0,0 +1,156 @@
+// Enregistrement de configuration TLV (eeprom_store.cpp) sur une EEPROM RAM: migration des
+// anciens formats, versions de section, seuils v1 -> v2, sections inconnues conservées.
+// Chaque boot() est un démarrage à froid.
+#include <unity.h>
+#include <host_boot.h>
+#include "eeprom_store.h"
+
+namespace {
+constexpr size_t kKeys = (size_t)N_MUX * N_CH;
+constexpr uint16_t kOldCurvesA = 1548;
+constexpr uint8_t kCurvesLen = 100;
+constexpr float kGamma = 1.7f;
+
+uint32_t crc32(const uint8_t* p, size_t n) {
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < n; i++) {
+        c ^= p[i];
+        for (int k = 0; k < 8; k++) c = (c >> 1) ^ (0xEDB88320u & (0u - (c & 1u)));
+    }
+    return ~c;
+}
+
+uint16_t lowOf(size_t k) { return (uint16_t)(200 + k % 50); }
+uint16_t highOf(size_t k) { return (uint16_t)(850 + k % 70); }
+uint8_t curveByte(size_t i) { return (uint8_t)(i * 3 + 1); }
+
+// Earlier firmware: v2 thresholds block at 0 ('J2TH' header, low[], high[], gamma)
+// and the old Curves block ('J2BK', id 1) in its A slot
+void writeLegacy() {
+    hostEepromErase();
+    uint8_t payload[kKeys * 4 + sizeof(float)];
+    for (size_t k = 0; k < kKeys; k++) {
+        payload[2 * k] = (uint8_t)lowOf(k);
+        payload[2 * k + 1] = (uint8_t)(lowOf(k) >> 8);
+        payload[kKeys * 2 + 2 * k] = (uint8_t)highOf(k);
+        payload[kKeys * 2 + 2 * k + 1] = (uint8_t)(highOf(k) >> 8);
+    }
+    memcpy(payload + kKeys * 4, &kGamma, sizeof(float));
+    struct __attribute__((packed)) { uint32_t magic; uint16_t version, nMux, nCh; uint32_t crc; } th{
+        0x4A325448, 2, N_MUX, N_CH, crc32(payload, sizeof(payload))};
+    memcpy(gShared->mem, &th, sizeof(th));
+    memcpy(gShared->mem + sizeof(th), payload, sizeof(payload));
+
+    uint8_t curves[kCurvesLen];
+    for (size_t i = 0; i < kCurvesLen; i++) curves[i] = curveByte(i);
+    struct __attribute__((packed)) { uint32_t magic; uint8_t id, gen; uint16_t len; uint32_t crc; } blk{
+        0x4A32424B, 1, 1, kCurvesLen, crc32(curves, kCurvesLen)};
+    memcpy(gShared->mem + kOldCurvesA, &blk, sizeof(blk));
+    memcpy(gShared->mem + kOldCurvesA + sizeof(blk), curves, kCurvesLen);
+}
+
+void commit() {
+    for (uint32_t i = 0; EepromStore::saveBusy() && i < 100000; i++) EepromStore::service(16);
+}
+
+bool legacyThresholds() {
+    uint16_t low[N_MUX][N_CH], high[N_MUX][N_CH];
+    float gamma = 0.f;
+    if (!EepromStore::load(low, high, &gamma) || gamma != kGamma) return false;
+    for (size_t k = 0; k < kKeys; k++) {
+        if (low[k / N_CH][k % N_CH] != lowOf(k) || high[k / N_CH][k % N_CH] != highOf(k)) return false;
+    }
+    return true;
+}
+
+bool legacyCurves() {
+    uint8_t buf[kCurvesLen];
+    if (EepromStore::loadSection(EepromStore::Section::Curves, buf, sizeof(buf)) != kCurvesLen) return false;
+    for (size_t i = 0; i < kCurvesLen; i++) {
+        if (buf[i] != curveByte(i)) return false;
+    }
+    return true;
+}
+}
+
+void setUp() {}
+void tearDown() {}
+
+// Old blocks are read into the TLV record (thresholds as v1) and committed once
+void test_migrates_legacy_blocks() {
+    writeLegacy();
+    TEST_ASSERT_EQUAL(0, boot([] {
+        BOOT_CHECK(legacyThresholds());
+        BOOT_CHECK(legacyCurves());
+        BOOT_CHECK(EepromStore::sectionVersion(EepromStore::Section::Thresholds) == 1);
+        BOOT_CHECK(EepromStore::sectionVersion(EepromStore::Section::Layout) == 0);
+        uint16_t rest[N_MUX][N_CH], peak[N_MUX][N_CH];
+        BOOT_CHECK(!EepromStore::loadTravel(rest, peak)); // v1 has no travel ends
+        BOOT_CHECK(EepromStore::saveBusy());               // migrated record queued
+        commit();
+    }));
+    TEST_ASSERT_EQUAL(0, boot([] {
+        BOOT_CHECK(!EepromStore::saveBusy()); // record found: no second migration
+        BOOT_CHECK(legacyThresholds());
+        BOOT_CHECK(legacyCurves());
+    }));
+}
+
+// Saving thresholds rewrites them as v2 (with travel ends) and keeps the other sections
+void test_thresholds_v1_to_v2() {
+    writeLegacy();
+    TEST_ASSERT_EQUAL(0, boot([] {
+        uint16_t low[N_MUX][N_CH], high[N_MUX][N_CH], rest[N_MUX][N_CH], peak[N_MUX][N_CH];
+        BOOT_CHECK(EepromStore::load(low, high));
+        for (size_t k = 0; k < kKeys; k++) {
+            rest[k / N_CH][k % N_CH] = (uint16_t)(lowOf(k) - 30);
+            peak[k / N_CH][k % N_CH] = (uint16_t)(highOf(k) + 40);
+        }
+        BOOT_CHECK(EepromStore::beginSave(low, high, rest, peak));
+        commit();
+    }));
+    TEST_ASSERT_EQUAL(0, boot([] {
+        BOOT_CHECK(EepromStore::sectionVersion(EepromStore::Section::Thresholds) == 2);
+        BOOT_CHECK(legacyThresholds()); // gamma untouched (nullptr on save)
+        BOOT_CHECK(legacyCurves());
+        uint16_t rest[N_MUX][N_CH], peak[N_MUX][N_CH];
+        BOOT_CHECK(EepromStore::loadTravel(rest, peak));
+        for (size_t k = 0; k < kKeys; k++) {
+            BOOT_CHECK(rest[k / N_CH][k % N_CH] == lowOf(k) - 30);
+            BOOT_CHECK(peak[k / N_CH][k % N_CH] == highOf(k) + 40);
+        }
+    }));
+}
+
+// A section written by newer firmware (higher version) or with an unknown tag is kept but
+// never copied into the current layout; the other sections still load
+void test_newer_section_version_is_skipped() {
+    writeLegacy();
+    TEST_ASSERT_EQUAL(0, boot([] {
+        const uint8_t layout[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+        BOOT_CHECK(EepromStore::saveSection(EepromStore::Section::Layout, layout, sizeof(layout), 7));
+        const uint8_t future[4] = {9, 9, 9, 9};
+        BOOT_CHECK(EepromStore::saveSection((EepromStore::Section)42, future, sizeof(future)));
+        commit();
+    }));
+    TEST_ASSERT_EQUAL(0, boot([] {
+        BOOT_CHECK(EepromStore::sectionVersion(EepromStore::Section::Layout) == 7);
+        uint8_t buf[8];
+        memset(buf, 0xAA, sizeof(buf));
+        BOOT_CHECK(EepromStore::loadSection(EepromStore::Section::Layout, buf, sizeof(buf)) == 0);
+        BOOT_CHECK(buf[0] == 0xAA && buf[7] == 0xAA);
+        BOOT_CHECK(EepromStore::loadSection(EepromStore::Section::Layout, buf, sizeof(buf), 7) == sizeof(buf));
+        BOOT_CHECK(buf[0] == 1 && buf[7] == 8);
+        BOOT_CHECK(EepromStore::sectionVersion((EepromStore::Section)42) == 1);
+        BOOT_CHECK(legacyThresholds());
+        BOOT_CHECK(legacyCurves());
+    }));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_migrates_legacy_blocks);
+    RUN_TEST(test_thresholds_v1_to_v2);
+    RUN_TEST(test_newer_section_version_is_skipped);
+    return UNITY_END();
+}
@@ -0,0 +1,111 @@
+// Estimateur de médiane en flux (median_est.h) contre la médiane exacte d'un histogramme,
+// sur des signaux de repos simulés: bruit gaussien, départ loin du repos (touche tenue au
+// lancement de la Phase 1), pics pleine échelle.
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include "median_est.h"
+
+namespace {
+constexpr int kSamples = 6000;   // ~2 s de Phase 1
+constexpr int kMaxErr = 2;       // LSB
+
+uint32_t sSeed = 1;
+float uniform() {
+    sSeed = sSeed * 1664525u + 1013904223u;
+    return (float)((sSeed >> 8) + 1) / 16777218.0f;
+}
+float gaussian() {
+    return sqrtf(-2.0f * logf(uniform())) * cosf(6.2831853f * uniform());
+}
+
+uint16_t clampAdc(float v) {
+    if (v < 0.f) return 0;
+    if (v > 1023.f) return 1023;
+    return (uint16_t)lrintf(v);
+}
+
+// Exact lower median from a 1024-bin histogram
+uint16_t exactMedian(const uint16_t* hist, int n) {
+    int acc = 0;
+    for (uint16_t v = 0; v < 1024; v++) {
+        acc += hist[v];
+        if (2 * acc >= n) return v;
+    }
+    return 1023;
+}
+
+// Feed kSamples samples around rest; returns |estimate - exact median|
+int runCase(float rest, float sigma, int startOffset, bool spikes, uint32_t seed) {
+    sSeed = seed;
+    static uint16_t hist[1024];
+    for (auto& h : hist) h = 0;
+    MedianEst e{};
+    uint16_t smoothQ4 = 0;
+    for (int i = 0; i < kSamples; i++) {
+        uint16_t v;
+        if (i == 0) v = clampAdc(rest + (float)startOffset);
+        else if (spikes && i % 100 == 50) v = 1023;
+        else v = clampAdc(rest + sigma * gaussian());
+        hist[v]++;
+        if (i == 0) {
+            medianStart(e, v);
+            smoothQ4 = (uint16_t)(v << 4);
+        } else {
+            medianUpdate(e, v);
+            medianSmooth(smoothQ4, e);
+        }
+    }
+    return abs((int)medianSmoothed(smoothQ4) - (int)exactMedian(hist, kSamples));
+}
+} // namespace
+
+void test_median_matches_exact_quiet_start(void) {
+    const float sigmas[] = {0.5f, 1.f, 2.f, 4.f, 8.f};
+    for (float s : sigmas) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "sigma=%.1f", (double)s);
+        TEST_ASSERT_INT_WITHIN_MESSAGE(kMaxErr, 0, runCase(740.3f, s, 0, false, 7u), msg);
+    }
+}
+
+void test_median_converges_from_far_start(void) {
+    const int offsets[] = {-300, 300};
+    const float sigmas[] = {0.5f, 2.f, 8.f};
+    for (int o : offsets) {
+        for (float s : sigmas) {
+            char msg[64];
+            snprintf(msg, sizeof(msg), "offset=%d sigma=%.1f", o, (double)s);
+            TEST_ASSERT_INT_WITHIN_MESSAGE(kMaxErr, 0, runCase(512.6f, s, o, false, 11u), msg);
+        }
+    }
+}
+
+void test_median_ignores_full_scale_spikes(void) {
+    const float sigmas[] = {1.f, 4.f, 8.f};
+    for (float s : sigmas) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "sigma=%.1f", (double)s);
+        TEST_ASSERT_INT_WITHIN_MESSAGE(kMaxErr, 0, runCase(300.0f, s, 0, true, 23u), msg);
+    }
+}
+
+void test_median_tracks_rest_anywhere_on_scale(void) {
+    for (int rest = 40; rest < 1000; rest += 97) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "rest=%d", rest);
+        TEST_ASSERT_INT_WITHIN_MESSAGE(kMaxErr, 0, runCase((float)rest + 0.25f, 2.f, 0, false, (uint32_t)rest), msg);
+    }
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+int main(int, char**) {
+    UNITY_BEGIN();
+    RUN_TEST(test_median_matches_exact_quiet_start);
+    RUN_TEST(test_median_converges_from_far_start);
+    RUN_TEST(test_median_ignores_full_scale_spikes);
+    RUN_TEST(test_median_tracks_rest_anywhere_on_scale);
+    return UNITY_END();
+}
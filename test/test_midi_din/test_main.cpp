@@ -0,0 +1,194 @@
+// Backend MIDI DIN (midi_din.cpp) sur un faux UART (ByteSink): running status et son
+// rafraîchissement, report des NoteOff et ordre garanti, accords triés par vélocité,
+// amincissement des données continues.
+#include <unity.h>
+#include <vector>
+#include "config.h"
+#include "midi_din.h"
+
+namespace {
+using MidiOut::Event;
+using MidiOut::Kind;
+
+std::vector<uint8_t> sOut;
+int sRoom = 0; // bytes the fake UART accepts without blocking
+
+int sinkAvailable() { return sRoom; }
+void sinkWrite(uint8_t b) { sOut.push_back(b); sRoom--; }
+
+struct Msg { uint8_t status, d1, d2; };
+
+// Wire bytes back into messages (running status applied, as a receiver would)
+std::vector<Msg> parse() {
+    std::vector<Msg> msgs;
+    uint8_t status = 0;
+    size_t i = 0;
+    while (i < sOut.size()) {
+        if (sOut[i] & 0x80) status = sOut[i++];
+        const bool oneByte = (status & 0xF0) == 0xD0;
+        Msg m{status, sOut[i], oneByte ? (uint8_t)0 : sOut[i + 1]};
+        i += oneByte ? 1 : 2;
+        msgs.push_back(m);
+    }
+    return msgs;
+}
+
+void noteOn(uint8_t note, uint8_t vel) { MidiDin::enqueue(Event{Kind::NoteOn, 1, note, vel}); }
+void noteOff(uint8_t note) { MidiDin::enqueue(Event{Kind::NoteOff, 1, note, 0}); }
+
+bool isOff(const Msg& m, uint8_t note) { return m.status == 0x90 && m.d1 == note && m.d2 == 0; }
+
+void flushAll() {
+    sRoom = 1 << 20;
+    MidiDin::service();
+}
+}
+
+void setUp() {
+    gHostMicros += 1000000; // past any refresh / thinning window of the previous test
+    MidiDin::init();
+    MidiDin::setSink(MidiDin::ByteSink{sinkAvailable, sinkWrite});
+    sOut.clear();
+    sRoom = 0;
+}
+void tearDown() {}
+
+// Status byte only when it changes; NoteOff as NoteOn velocity 0 keeps it running
+void test_running_status() {
+    noteOn(60, 100);
+    flushAll();
+    noteOn(62, 90);
+    noteOff(60);
+    flushAll();
+    const uint8_t expect[] = {0x90, 60, 100, 62, 90, 60, 0};
+    TEST_ASSERT_EQUAL(sizeof(expect), sOut.size());
+    for (size_t i = 0; i < sizeof(expect); i++) TEST_ASSERT_EQUAL(expect[i], sOut[i]);
+    MidiDin::Stats st;
+    MidiDin::takeStats(st);
+    TEST_ASSERT_EQUAL(2, st.runningStatusSaved);
+    TEST_ASSERT_EQUAL(7, st.bytes);
+}
+
+// After kDinRunningStatusRefreshMs the status is sent again (receiver plugged in mid-stream)
+void test_running_status_refresh() {
+    noteOn(60, 100);
+    flushAll();
+    gHostMicros += (kDinRunningStatusRefreshMs - 1) * 1000u;
+    noteOn(61, 100);
+    flushAll();
+    TEST_ASSERT_EQUAL(5, sOut.size()); // still running
+    gHostMicros += 2000;
+    noteOn(62, 100);
+    flushAll();
+    TEST_ASSERT_EQUAL(8, sOut.size());
+    TEST_ASSERT_EQUAL(0x90, sOut[5]);
+}
+
+// A message never goes out partially: a line without room for it keeps it queued
+void test_waits_for_room() {
+    noteOn(60, 100);
+    sRoom = 2;
+    MidiDin::service();
+    TEST_ASSERT_EQUAL(0, sOut.size());
+    sRoom = 3;
+    MidiDin::service();
+    TEST_ASSERT_EQUAL(3, sOut.size());
+}
+
+// Back-to-back NoteOns leave loudest first; a NoteOff ends the chord window
+void test_chord_loudest_first() {
+    noteOn(60, 30);
+    noteOn(64, 100);
+    noteOn(67, 60);
+    noteOff(50);
+    noteOn(72, 10);
+    noteOn(76, 120);
+    flushAll();
+    const std::vector<Msg> m = parse();
+    TEST_ASSERT_EQUAL(6, m.size());
+    TEST_ASSERT_EQUAL(64, m[0].d1);
+    TEST_ASSERT_EQUAL(67, m[1].d1);
+    TEST_ASSERT_EQUAL(60, m[2].d1);
+    TEST_ASSERT_TRUE(isOff(m[3], 50));
+    TEST_ASSERT_EQUAL(76, m[4].d1);
+    TEST_ASSERT_EQUAL(72, m[5].d1);
+}
+
+// Full queue: a NoteOff is deferred (never lost), a NoteOn is dropped; a deferred NoteOff goes
+// back ahead of anything queued after it, so it never cuts a newer NoteOn of the same pitch
+void test_noteoff_deferred_in_order() {
+    const uint16_t capacity = kDinQueueSize - 1;
+    for (uint16_t i = 0; i < capacity; i++) noteOn((uint8_t)(i & 0x3F) + 64, 100);
+    noteOff(5);
+    noteOn(6, 100); // no room, not a NoteOff: dropped
+    MidiDin::Stats st;
+    MidiDin::takeStats(st);
+    TEST_ASSERT_EQUAL(1, st.noteOffDeferred);
+    TEST_ASSERT_EQUAL(1, st.noteOnDropped);
+
+    sRoom = 5; // status + 2 running-status messages
+    MidiDin::service();
+    noteOn(5, 99); // queued behind the reinjected NoteOff
+    flushAll();
+    const std::vector<Msg> m = parse();
+    TEST_ASSERT_EQUAL(capacity + 2, m.size());
+    size_t off = m.size(), on = m.size();
+    for (size_t i = 0; i < m.size(); i++) {
+        if (isOff(m[i], 5)) off = i;
+        if (m[i].d1 == 5 && m[i].d2 == 99) on = i;
+    }
+    TEST_ASSERT_TRUE(off < m.size());
+    TEST_ASSERT_TRUE(on < m.size());
+    TEST_ASSERT_TRUE(off < on);
+}
+
+// Continuous data: latest value per controller, after the notes, at most one per kDinContMinGapUs
+void test_continuous_thinning() {
+    for (uint8_t v = 1; v <= 50; v++) MidiDin::enqueue(Event{Kind::CC, 1, 7, v});
+    MidiDin::enqueue(Event{Kind::CC, 1, 10, 64});
+    noteOn(60, 100);
+    flushAll();
+    std::vector<Msg> m = parse();
+    TEST_ASSERT_EQUAL(2, m.size());
+    TEST_ASSERT_EQUAL(0x90, m[0].status);
+    TEST_ASSERT_EQUAL(0xB0, m[1].status);
+    TEST_ASSERT_EQUAL(7, m[1].d1);
+    TEST_ASSERT_EQUAL(50, m[1].d2);
+    flushAll(); // too soon for the next controller
+    TEST_ASSERT_EQUAL(2, parse().size());
+    gHostMicros += kDinContMinGapUs;
+    flushAll();
+    m = parse();
+    TEST_ASSERT_EQUAL(3, m.size());
+    TEST_ASSERT_EQUAL(10, m[2].d1);
+    MidiDin::Stats st;
+    MidiDin::takeStats(st);
+    TEST_ASSERT_EQUAL(49, st.contThinned);
+}
+
+// An ordered event supersedes the pending coalesced value of its controller and keeps its place
+void test_in_order_supersedes_coalesced() {
+    MidiDin::enqueue(Event{Kind::ChannelPressure, 2, 90, 0});
+    MidiDin::enqueueInOrder(Event{Kind::ChannelPressure, 2, 0, 0});
+    MidiDin::enqueue(Event{Kind::NoteOn, 2, 60, 100});
+    flushAll();
+    gHostMicros += kDinContMinGapUs;
+    flushAll();
+    const std::vector<Msg> m = parse();
+    TEST_ASSERT_EQUAL(2, m.size());
+    TEST_ASSERT_EQUAL(0xD1, m[0].status);
+    TEST_ASSERT_EQUAL(0, m[0].d1);
+    TEST_ASSERT_EQUAL(0x91, m[1].status);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_running_status);
+    RUN_TEST(test_running_status_refresh);
+    RUN_TEST(test_waits_for_room);
+    RUN_TEST(test_chord_loudest_first);
+    RUN_TEST(test_noteoff_deferred_in_order);
+    RUN_TEST(test_continuous_thinning);
+    RUN_TEST(test_in_order_supersedes_coalesced);
+    return UNITY_END();
+}
@@ -0,0 +1,161 @@
+// Rejeu de frappes synthétiques par les deux chemins de vélocité: 2 points (départ →
+// déclenchement) et 3 points (stroke_speed.h), avec la même égalisation (VelocityEq) et la
+// même courbe. Imprime les deux vélocités par frappe; vérifie l'accord à vitesse constante et
+// le sens de l'écart quand la vitesse change en cours de course.
+#include <unity.h>
+#include <stdio.h>
+#include <EEPROM.h>
+#include "config.h"
+#include "stroke_speed.h"
+#include "velocity_calc.h"
+#include "velocity_eq.h"
+#include "note_map.h"
+
+namespace {
+constexpr uint32_t kScanUs = 100;       // période d'échantillonnage d'une touche
+constexpr uint16_t kRest = 512;
+constexpr uint16_t kLow = 560;
+constexpr uint16_t kHigh = 700;
+constexpr uint16_t kMid = (kLow + kHigh) / 2;
+constexpr uint8_t kMux = 0, kCh = 0;
+// Deltas in the unit of the active path: ADC counts, or µm with kVelocityUseTravel
+// (~23 µm per count: the ~175-count / 4 mm swing behind the bounds of velocity_calc.h)
+constexpr uint16_t kUnit = kVelocityUseTravel ? 23 : 1;
+uint32_t sNowMs = 0;
+
+uint8_t sEepromMem[HostEeprom::kSize]; // blank: default curves and layout
+
+// Course à deux vitesses (counts/µs): v1 jusqu'au seuil médian, v2 ensuite
+struct Stroke { const char* name; float v1; float v2; };
+
+struct Replay { uint8_t two, three, profile; uint32_t dt; };
+
+float adcAt(const Stroke& st, float t) {
+    const float tMid = (float)(kMid - kRest) / st.v1;
+    if (t < tMid) return kRest + st.v1 * t;
+    return kMid + st.v2 * (t - tMid);
+}
+
+// Même découpage que VelocityEngine (IDLE → TRACKING → déclenchement), mêmes deltas,
+// puis chaque chemin passe par VelocityEq::scale et computeVelocity
+Replay replay(const Stroke& st, uint32_t phaseUs) {
+    uint16_t adcStart = 0, adcMid = 0;
+    uint32_t tStart = 0, tMid = 0;
+    bool tracking = false, midSeen = false;
+    uint16_t prev = kRest;
+    for (uint32_t t = phaseUs;; t += kScanUs) {
+        const uint16_t adc = (uint16_t)adcAt(st, (float)t);
+        if (!tracking) {
+            if (adc >= kLow && prev < kLow) { tracking = true; adcStart = adc; tStart = t; }
+        } else {
+            if (!midSeen && adc >= kMid) { midSeen = true; adcMid = adc; tMid = t; }
+            if (adc >= kHigh) {
+                const uint32_t dt = t - tStart;
+                const uint16_t delta = (uint16_t)((adc - adcStart) * kUnit);
+                uint16_t fused = delta;
+                uint8_t profile = 64;
+                if (midSeen && tMid > tStart && t > tMid) {
+                    const StrokeSegments seg{(uint16_t)((adcMid - adcStart) * kUnit), tMid - tStart,
+                                             (uint16_t)((adc - adcMid) * kUnit), t - tMid};
+                    profile = strokeProfile(seg);
+                    fused = threePointDelta(seg, dt, kThreePointLateWeight);
+                }
+                return Replay{computeVelocity(kMux, kCh, VelocityEq::scale(kMux, kCh, delta), dt),
+                              computeVelocity(kMux, kCh, VelocityEq::scale(kMux, kCh, fused), dt),
+                              profile, dt};
+            }
+        }
+        prev = adc;
+    }
+}
+
+Replay replayPrinted(const Stroke& st) {
+    const Replay r = replay(st, 37);
+    printf("[VEL] %-12s v1=%.4f v2=%.4f dt=%lu two=%u three=%u profile=%u gain=%u\n", st.name, st.v1, st.v2,
+           (unsigned long)r.dt, r.two, r.three, r.profile, VelocityEq::gainQ8(kMux, kCh));
+    return r;
+}
+
+// Non-neutral EQ on the replayed key: it plays softer than its neighbour
+void learnGain() {
+    for (uint8_t i = 0; i < 2 * VelocityEq::kMinNotes; i++) {
+        VelocityEq::apply(kMux, kCh, 140 * kUnit, 10000);
+        VelocityEq::apply(kMux, kCh + 1, 140 * kUnit, 7000);
+    }
+    sNowMs += VelocityEq::kRecomputeMs;
+    VelocityEq::service(sNowMs);
+}
+}
+
+void setUp() {
+    if (!EEPROM.mem) {
+        memset(sEepromMem, 0xFF, sizeof(sEepromMem));
+        EEPROM.mem = sEepromMem;
+    }
+    noteMapInit();
+    VelocityCurves::init();
+    VelocityEq::reset();
+    learnGain();
+}
+void tearDown() {}
+
+// The learned gain is the one both paths see, and scale() does not learn again
+void test_same_eq_both_paths() {
+    TEST_ASSERT_TRUE(VelocityEq::gainQ8(kMux, kCh) > 256);
+    const uint16_t scaled = VelocityEq::scale(kMux, kCh, 100);
+    TEST_ASSERT_EQUAL(scaled, VelocityEq::apply(kMux, kCh, 100, 10000));
+    TEST_ASSERT_EQUAL(scaled, VelocityEq::scale(kMux, kCh, 100));
+}
+
+// Constant speed: both paths agree (sampling quantization only) and rise with speed
+void test_constant_speed_agrees() {
+    const Stroke strokes[] = {
+        {"pp", 0.002f, 0.002f}, {"p", 0.004f, 0.004f}, {"mf", 0.008f, 0.008f},
+        {"f", 0.015f, 0.015f},  {"ff", 0.03f, 0.03f},
+    };
+    uint8_t lastTwo = 0, lastThree = 0;
+    for (const Stroke& st : strokes) {
+        const Replay r = replayPrinted(st);
+        TEST_ASSERT_INT_WITHIN_MESSAGE(3, r.two, r.three, st.name);
+        TEST_ASSERT_INT_WITHIN_MESSAGE(8, 64, r.profile, st.name);
+        TEST_ASSERT_TRUE(r.two >= lastTwo);
+        TEST_ASSERT_TRUE(r.three >= lastThree);
+        lastTwo = r.two;
+        lastThree = r.three;
+    }
+}
+
+// Speed change mid-stroke: three-point follows the end of travel, two-point the average
+void test_speed_change_direction() {
+    const Replay late = replayPrinted(Stroke{"slow->fast", 0.003f, 0.03f});
+    TEST_ASSERT_TRUE(late.three > late.two);
+    TEST_ASSERT_TRUE(late.profile > 64);
+    const Replay early = replayPrinted(Stroke{"fast->slow", 0.03f, 0.003f});
+    TEST_ASSERT_TRUE(early.three > early.two); // late-weighted: a stalled finish still reads the fast start
+    TEST_ASSERT_TRUE(early.profile < 64);
+}
+
+// Sampling phase moves the crossings by up to one scan period; neither path should jump
+void test_phase_stability() {
+    const Stroke st{"phase", 0.01f, 0.01f};
+    uint8_t minTwo = 127, maxTwo = 0, minThree = 127, maxThree = 0;
+    for (uint32_t ph = 0; ph < kScanUs; ph += 7) {
+        const Replay r = replay(st, ph);
+        if (r.two < minTwo) minTwo = r.two;
+        if (r.two > maxTwo) maxTwo = r.two;
+        if (r.three < minThree) minThree = r.three;
+        if (r.three > maxThree) maxThree = r.three;
+    }
+    printf("[VEL] phase spread two=%u..%u three=%u..%u\n", minTwo, maxTwo, minThree, maxThree);
+    TEST_ASSERT_TRUE(maxTwo - minTwo <= 3);
+    TEST_ASSERT_TRUE(maxThree - minThree <= 4);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_same_eq_both_paths);
+    RUN_TEST(test_constant_speed_agrees);
+    RUN_TEST(test_speed_change_direction);
+    RUN_TEST(test_phase_stability);
+    return UNITY_END();
+}